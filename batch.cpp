@@ -0,0 +1,274 @@
+#include "brlyt.h"
+#include "brlan.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+using namespace bq;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief fixed set of tasks spread over per-worker queues
+ *
+ * Every worker drains its own queue from the back and, once it is empty,
+ * steals from the front of the other queues, so a few huge files do not
+ * leave the other threads idle.
+ */
+class WorkStealingPool {
+    public:
+    explicit WorkStealingPool(unsigned threadCount) : queues(threadCount) {};
+    void add(std::function<void()> task) {
+        auto &queue = queues[nextQueue++ % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    };
+    /**
+     * @brief runs every task and returns once all of them are done
+     */
+    void run() {
+        std::vector<std::thread> threads;
+        threads.reserve(queues.size());
+        for (std::size_t i=0; i<queues.size(); ++i) {
+            threads.emplace_back([this, i] { work(i); });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    };
+    private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    std::vector<Queue> queues;
+    std::size_t nextQueue = 0;
+    bool pop(std::size_t index, std::function<void()> &task) {
+        auto &queue = queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    };
+    bool steal(std::size_t thief, std::function<void()> &task) {
+        for (std::size_t i=1; i<queues.size(); ++i) {
+            auto &queue = queues[(thief + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    };
+    void work(std::size_t index) {
+        // no task adds new tasks, so once every queue is empty the work is done
+        std::function<void()> task;
+        while (pop(index, task) || steal(index, task)) {
+            task();
+        }
+    };
+};
+
+struct Options {
+    fs::path outputDir;
+    unsigned threads = 0;
+    bool dedupMaterials = false;
+    bool swapEndian = false;
+    bool verbose = false;
+    SectionObserver *observer = nullptr;
+};
+
+struct Job {
+    fs::path input;
+    fs::path relative; // path below the output directory
+};
+
+static bool isLayoutFile(const fs::path &path) {
+    auto ext = path.extension();
+    return ext == ".brlyt" || ext == ".brlan";
+}
+
+static void addInput(const fs::path &path, std::vector<Job> &jobs) {
+    if (fs::is_directory(path)) {
+        for (auto &entry: fs::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file() && isLayoutFile(entry.path())) {
+                jobs.push_back({entry.path(), fs::relative(entry.path(), path)});
+            }
+        }
+    } else {
+        jobs.push_back({path, path.filename()});
+    }
+}
+
+static void addInputList(const fs::path &listPath, std::vector<Job> &jobs) {
+    std::ifstream list(listPath);
+    if (!list) {
+        throw std::runtime_error("cannot open file list " + listPath.string());
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty()) {
+            addInput(line, jobs);
+        }
+    }
+}
+
+/**
+ * @brief throws if two jobs would write the same output file
+ *
+ * Files named on the command line keep only their filename below the output
+ * directory, so a/x.brlyt and b/x.brlyt would overwrite each other.
+ */
+static void checkOutputPaths(const std::vector<Job> &jobs) {
+    std::unordered_map<std::string, const Job *> outputs;
+    for (auto &job: jobs) {
+        auto [it, inserted] = outputs.emplace(job.relative.lexically_normal().string(), &job);
+        if (!inserted) {
+            throw std::runtime_error(it->second->input.string() + " and " + job.input.string() + " would both be written to " + it->first);
+        }
+    }
+}
+
+template<class Document>
+static std::vector<char> convert(const MappedFile &file, const Options &options) {
+    Document document;
+    // files are already spread over every core, so each one is parsed serially
+    document.readOptions.threads = 1;
+    document.observer = options.observer;
+    document.read(file.data(), file.size());
+    if constexpr (std::is_same_v<Document, brlyt::Brlyt>) {
+        if (options.dedupMaterials) {
+            document.dedupMaterials();
+        }
+    }
+    if (options.swapEndian) {
+        document.bom = document.bom == 0xfeff ? 0xfffe : 0xfeff;
+    }
+    return document.serialize();
+}
+
+/**
+ * @brief parses, transforms and writes one file and returns its input size
+ */
+static std::size_t processFile(const Job &job, const Options &options) {
+    MappedFile file(job.input.string());
+    auto output = job.input.extension() == ".brlan" ? convert<brlan::Brlan>(file, options) : convert<brlyt::Brlyt>(file, options);
+    if (!options.outputDir.empty()) {
+        auto outPath = options.outputDir / job.relative;
+        fs::create_directories(outPath.parent_path());
+        std::ofstream out(outPath, std::ios::binary);
+        out.write(output.data(), output.size());
+        if (!out) {
+            throw std::runtime_error("cannot write " + outPath.string());
+        }
+    }
+    return file.size();
+}
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: becquerel-batch [options] <file|directory|@list>...\n"
+        "  -o <dir>             write converted files below dir (default: round-trip only)\n"
+        "  -j <n>               worker threads (default: every core)\n"
+        "  --dedup-materials    merge identical materials in layouts\n"
+        "  --swap-endian        write files in the opposite byte order\n"
+        "  -v                   print a line per file\n"
+        "  --stats              print the time spent per section type\n");
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    SectionHistogram histogram;
+    std::vector<Job> jobs;
+    try {
+        for (int i=1; i<argc; ++i) {
+            std::string arg = argv[i];
+            if ((arg == "-o" || arg == "-j") && i + 1 >= argc) {
+                usage();
+                return 1;
+            }
+            if (arg == "-o") {
+                options.outputDir = argv[++i];
+            } else if (arg == "-j") {
+                options.threads = std::stoul(argv[++i]);
+            } else if (arg == "--dedup-materials") {
+                options.dedupMaterials = true;
+            } else if (arg == "--swap-endian") {
+                options.swapEndian = true;
+            } else if (arg == "-v") {
+                options.verbose = true;
+            } else if (arg == "--stats") {
+#ifndef BECQUEREL_INSTRUMENT
+                std::fprintf(stderr, "warning: --stats needs a build with BECQUEREL_INSTRUMENT\n");
+#endif
+                options.observer = &histogram;
+            } else if (arg == "-h" || arg == "--help") {
+                usage();
+                return 0;
+            } else if (arg[0] == '@') {
+                addInputList(arg.substr(1), jobs);
+            } else {
+                addInput(arg, jobs);
+            }
+        }
+        if (!options.outputDir.empty()) {
+            checkOutputPaths(jobs);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    if (jobs.empty()) {
+        usage();
+        return 1;
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::atomic<std::size_t> totalBytes(0);
+    std::atomic<std::size_t> failures(0);
+    std::mutex printMutex;
+    WorkStealingPool pool(options.threads);
+    for (auto &job: jobs) {
+        pool.add([&] {
+            auto start = Clock::now();
+            try {
+                auto bytes = processFile(job, options);
+                totalBytes += bytes;
+                if (options.verbose) {
+                    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    std::printf("%s: %zu bytes, %.3f ms, %.1f MB/s\n", job.input.string().c_str(), bytes, seconds * 1e3, bytes / seconds / 1e6);
+                }
+            } catch (const std::exception &e) {
+                ++failures;
+                std::lock_guard<std::mutex> lock(printMutex);
+                std::fprintf(stderr, "%s: error: %s\n", job.input.string().c_str(), e.what());
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    pool.run();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%zu files (%zu failed), %zu bytes in %.3f s on %u threads: %.1f files/s, %.1f MB/s\n",
+        jobs.size(), failures.load(), totalBytes.load(), seconds, options.threads, jobs.size() / seconds, totalBytes / seconds / 1e6);
+    if (options.observer) {
+        std::fflush(stdout);
+        histogram.print(std::cout);
+    }
+    return failures ? 1 : 0;
+}
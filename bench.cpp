@@ -0,0 +1,347 @@
+#include "generator.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace bq;
+using namespace bq::brlyt;
+using namespace bq::brlan;
+using namespace bq::generator;
+
+using Clock = std::chrono::steady_clock;
+
+// every heap allocation of the process goes through here, so benchmarks can report allocations per op
+static std::atomic<std::size_t> allocationCount(0);
+
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+static const char *benchFilter = nullptr;
+
+template<class F>
+static void bench(const std::string &name, std::size_t bytesPerOp, F &&f) {
+    if (benchFilter && name.find(benchFilter) == std::string::npos) {
+        return;
+    }
+    f(); // warm up
+    int iterations = 0;
+    auto allocationsBefore = allocationCount.load();
+    auto start = Clock::now();
+    Clock::duration elapsed;
+    do {
+        f();
+        ++iterations;
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(250));
+    double allocsPerOp = double(allocationCount.load() - allocationsBefore) / iterations;
+    double nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    if (bytesPerOp) {
+        std::printf("%-44s %12.1f ns/op %10.1f MB/s %10.1f allocs/op\n", name.c_str(), nsPerOp, bytesPerOp / nsPerOp * 1e3, allocsPerOp);
+    } else {
+        std::printf("%-44s %12.1f ns/op %15s %10.1f allocs/op\n", name.c_str(), nsPerOp, "", allocsPerOp);
+    }
+}
+
+static volatile float floatSink;
+static volatile std::size_t sizeSink;
+
+// the byte order check before this change: one std::reverse per field
+template<class T>
+static T readNumberReverse(BinaryReader &stream, bool reverseEndian) {
+    T res;
+    char *resPtr = reinterpret_cast<char *>(&res);
+    stream.read(resPtr, sizeof(T));
+    if (reverseEndian) {
+        std::reverse(resPtr, resPtr + sizeof(T));
+    }
+    return res;
+}
+
+static void benchEndian(bool revEndian) {
+    constexpr std::size_t count = 1 << 16;
+    std::vector<char> buffer(count * sizeof(float));
+    for (std::size_t i=0; i<count; ++i) {
+        float f = convertEndian<Endian::Big>(float(i));
+        std::memcpy(buffer.data() + i * sizeof(float), &f, sizeof(float));
+    }
+
+    std::vector<float> decoded(count);
+
+    bench("float array, std::reverse per field", buffer.size(), [&] {
+        BinaryReader reader(buffer.data(), buffer.size());
+        for (auto &value: decoded) {
+            value = readNumberReverse<float>(reader, revEndian);
+        }
+        floatSink = decoded.back();
+    });
+    bench("float array, runtime revEndian flag", buffer.size(), [&] {
+        BinaryReader reader(buffer.data(), buffer.size());
+        for (auto &value: decoded) {
+            value = readNumber<float>(reader, revEndian);
+        }
+        floatSink = decoded.back();
+    });
+    bench("float array, compile-time Endian", buffer.size(), [&] {
+        BinaryReader reader(buffer.data(), buffer.size());
+        withEndian(revEndian, [&](auto endian) {
+            for (auto &value: decoded) {
+                value = readNumber<float, decltype(endian)::value>(reader);
+            }
+        });
+        floatSink = decoded.back();
+    });
+    bench("float array, readArray bulk swap", buffer.size(), [&] {
+        BinaryReader reader(buffer.data(), buffer.size());
+        readArray(reader, decoded.data(), decoded.size(), revEndian);
+        floatSink = decoded.back();
+    });
+    bench("float array, writeArray bulk swap", buffer.size(), [&] {
+        BinaryWriter writer;
+        writer.reserve(buffer.size());
+        writeArray(decoded.data(), decoded.size(), writer, revEndian);
+        sizeSink = writer.size();
+    });
+
+    // short arrays, like the vectors and colors inside a pane, where per-call overhead dominates
+    for (std::size_t shortCount: {2, 3, 4, 8, 16, 32}) {
+        std::size_t shortBytes = shortCount * sizeof(float);
+        std::string suffix = ", " + std::to_string(shortCount) + " floats";
+        bench("short float array, std::reverse per field" + suffix, shortBytes * 1024, [&] {
+            for (std::size_t offset=0; offset<1024 * shortBytes; offset+=shortBytes) {
+                BinaryReader reader(buffer.data() + offset, shortBytes);
+                for (std::size_t i=0; i<shortCount; ++i) {
+                    decoded[offset / sizeof(float) + i] = readNumberReverse<float>(reader, revEndian);
+                }
+            }
+            floatSink = decoded[shortCount - 1];
+        });
+        bench("short float array, readArray bulk swap" + suffix, shortBytes * 1024, [&] {
+            for (std::size_t offset=0; offset<1024 * shortBytes; offset+=shortBytes) {
+                BinaryReader reader(buffer.data() + offset, shortBytes);
+                readArray(reader, decoded.data() + offset / sizeof(float), shortCount, revEndian);
+            }
+            floatSink = decoded[shortCount - 1];
+        });
+        bench("short float array, writeArray bulk swap" + suffix, shortBytes * 1024, [&] {
+            BinaryWriter writer;
+            writer.reserve(1024 * shortBytes);
+            for (std::size_t offset=0; offset<1024 * shortBytes; offset+=shortBytes) {
+                writeArray(decoded.data() + offset / sizeof(float), shortCount, writer, revEndian);
+            }
+            sizeSink = writer.size();
+        });
+    }
+
+    // a single Hermite curve with many keys
+    constexpr std::size_t keyCount = 4096;
+    BinaryWriter tagStream;
+    PaiTagEntry tagEntry = {0, 0, CurveType::Hermite, {}};
+    for (std::size_t i=0; i<keyCount; ++i) {
+        tagEntry.keyFrames.push_back({float(i), float(i) * 0.5f, 1.0f});
+    }
+    withEndian(revEndian, [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        tagEntry.write<E>(tagStream);
+        auto tagBuffer = tagStream.release();
+
+        bench("Hermite keys, KeyFrame::read per key", tagBuffer.size(), [&] {
+            BinaryReader reader(tagBuffer.data(), tagBuffer.size());
+            reader.seekg(0xc);
+            std::vector<KeyFrame> keyFrames(keyCount);
+            for (auto &keyFrame: keyFrames) {
+                keyFrame.read<E>(reader, CurveType::Hermite);
+            }
+            floatSink = keyFrames.back().value;
+        });
+        bench("Hermite keys, PaiTagEntry::read", tagBuffer.size(), [&] {
+            BinaryReader reader(tagBuffer.data(), tagBuffer.size());
+            PaiTagEntry entry;
+            entry.read<E>(reader);
+            floatSink = entry.keyFrames.back().value;
+        });
+    });
+}
+
+static LayoutParams layoutParams(std::size_t paneCount, std::size_t materialCount, bool bigEndian) {
+    LayoutParams params;
+    params.paneCount = paneCount;
+    params.maxDepth = 6;
+    params.materialCount = materialCount;
+    params.bigEndian = bigEndian;
+    return params;
+}
+
+static AnimationParams animationParams(std::size_t entryCount, std::size_t hermiteKeys, bool bigEndian) {
+    AnimationParams params;
+    params.entryCount = entryCount;
+    params.hermiteKeys = hermiteKeys;
+    params.bigEndian = bigEndian;
+    return params;
+}
+
+static void benchSections(bool bigEndian) {
+    auto layout = generateLayout(layoutParams(341, 40, bigEndian));
+
+    // string tables
+    Txl1<true> txl1;
+    for (std::size_t i=0; i<256; ++i) {
+        txl1.textures.push_back("ui/common/texture_" + std::to_string(i) + ".tpl");
+    }
+    // records are read and written in the document's byte order, picked once as Brlyt::read does
+    withEndian(layout.revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        BinaryWriter txl1Stream;
+        txl1.write<E>(txl1Stream, layout);
+        auto txl1Buffer = txl1Stream.release();
+        bench("txl1 string table read, 256 names", txl1Buffer.size(), [&] {
+            BinaryReader reader(txl1Buffer.data(), txl1Buffer.size());
+            Txl1<true> decoded;
+            decoded.read<E>(reader, layout);
+            sizeSink = decoded.textures.size();
+        });
+        bench("txl1 string table write, 256 names", txl1Buffer.size(), [&] {
+            BinaryWriter writer;
+            txl1.write<E>(writer, layout);
+            sizeSink = writer.size();
+        });
+
+        // materials
+        auto &material = *layout.mat1.materials[5];
+        BinaryWriter materialStream;
+        material.write<E>(materialStream, layout);
+        auto materialBuffer = materialStream.release();
+        bench("Material::read", materialBuffer.size(), [&] {
+            BinaryReader reader(materialBuffer.data(), materialBuffer.size());
+            brlyt::Material decoded;
+            decoded.read<E>(reader, layout);
+            sizeSink = decoded.tevStages.size();
+        });
+        bench("Material::write", materialBuffer.size(), [&] {
+            BinaryWriter writer;
+            material.write<E>(writer, layout);
+            sizeSink = writer.size();
+        });
+    });
+
+    // pane tree
+    auto paneCount = FlatPaneTree(layout.rootPane).size();
+    bench("FlatPaneTree build, " + std::to_string(paneCount) + " panes", 0, [&] {
+        FlatPaneTree tree(layout.rootPane);
+        sizeSink = tree.size();
+    });
+    FlatPaneTree tree(layout.rootPane);
+    bench("FlatPaneTree::toTree, " + std::to_string(paneCount) + " panes", 0, [&] {
+        sizeSink = tree.toTree()->children.size();
+    });
+    bench("Brlyt::rebuildPaneTable, " + std::to_string(paneCount) + " panes", 0, [&] {
+        layout.rebuildPaneTable();
+        sizeSink = layout.paneTable.size();
+    });
+    bench("pane type, dynamic_cast, " + std::to_string(paneCount) + " panes", 0, [&] {
+        std::size_t materials = 0;
+        for (auto &node: tree.nodes()) {
+            materials += dynamic_cast<Pic1 *>(node.pane) || dynamic_cast<Txt1 *>(node.pane);
+        }
+        sizeSink = materials;
+    });
+    bench("pane type, visitPane, " + std::to_string(paneCount) + " panes", 0, [&] {
+        std::size_t materials = 0;
+        for (auto &node: tree.nodes()) {
+            materials += visitPane(*node.pane, [](auto &pane) {
+                using Pane = std::decay_t<decltype(pane)>;
+                return std::is_same_v<Pane, Pic1> || std::is_same_v<Pane, Txt1>;
+            });
+        }
+        sizeSink = materials;
+    });
+    bench("Brlyt::findPanes, " + std::to_string(layout.rootGroup->children.size()) + " groups", 0, [&] {
+        std::size_t found = 0;
+        for (auto &group: layout.rootGroup->children) {
+            found += layout.findPanes(*group).size();
+        }
+        sizeSink = found;
+    });
+
+    // animation entries
+    auto params = animationParams(1, 64, bigEndian);
+    params.stepKeys = 0;
+    auto animation = generateAnimation(params);
+    withEndian(animation.revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        BinaryWriter entryStream;
+        animation.animationInfo.entries[0].write<E>(entryStream);
+        auto entryBuffer = entryStream.release();
+        bench("PaiEntry::read, 64 Hermite keys", entryBuffer.size(), [&] {
+            BinaryReader reader(entryBuffer.data(), entryBuffer.size());
+            PaiEntry entry;
+            entry.read<E>(reader);
+            floatSink = entry.tags[0].tagEntries[0].keyFrames.back().value;
+        });
+    });
+}
+
+template<class Document>
+static void benchDocument(const std::string &name, Document &document) {
+    auto buffer = document.serialize();
+    bench(name + " read, " + std::to_string(buffer.size()) + " bytes", buffer.size(), [&] {
+        Document decoded;
+        decoded.read(buffer.data(), buffer.size());
+        sizeSink = decoded.headerSize;
+    });
+    Document decoded;
+    decoded.read(buffer.data(), buffer.size());
+    bench(name + " serialize, " + std::to_string(buffer.size()) + " bytes", buffer.size(), [&] {
+        sizeSink = decoded.serialize().size();
+    });
+    bench(name + " round-trip, " + std::to_string(buffer.size()) + " bytes", buffer.size(), [&] {
+        Document decoded;
+        decoded.read(buffer.data(), buffer.size());
+        sizeSink = decoded.serialize().size();
+    });
+}
+
+static void benchDocuments(bool bigEndian) {
+    const std::pair<std::size_t, std::size_t> layoutSizes[] = {{21, 8}, {341, 40}, {5461, 400}};
+    for (auto [paneCount, materialCount]: layoutSizes) {
+        auto layout = generateLayout(layoutParams(paneCount, materialCount, bigEndian));
+        benchDocument("Brlyt", layout);
+    }
+    const std::pair<std::size_t, std::size_t> animationSizes[] = {{16, 8}, {128, 32}, {1024, 64}};
+    for (auto [entryCount, keyCount]: animationSizes) {
+        auto animation = generateAnimation(animationParams(entryCount, keyCount, bigEndian));
+        benchDocument("Brlan", animation);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // the byte order is only known at run time, as with a real file
+    bool revEndian = NATIVE_ENDIAN != Endian::Big;
+    for (int i=1; i<argc; ++i) {
+        if (std::string(argv[i]) == "--native") {
+            revEndian = false;
+        } else {
+            benchFilter = argv[i];
+        }
+    }
+    bool bigEndian = (NATIVE_ENDIAN == Endian::Big) != revEndian;
+    std::printf("byte order: %s\n", revEndian ? "swapped" : "native");
+    benchEndian(revEndian);
+    benchSections(bigEndian);
+    benchDocuments(bigEndian);
+    return 0;
+}
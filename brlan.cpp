@@ -2,275 +2,322 @@
 
 namespace bq::brlan {
 
-void Pat1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+template<Endian E>
+void Pat1::read(BinaryReader &stream, const BaseHeader &) {
     auto startPos = stream.tellg() - std::streamoff(8);
-    animationOrder = readNumber<std::uint16_t>(stream, revEndian);
-    auto groupCount = readNumber<std::uint16_t>(stream, revEndian);
-    auto animNameOffset = readNumber<std::uint32_t>(stream, revEndian);
-    auto groupNamesOffset = readNumber<std::uint32_t>(stream, revEndian);
-    startFrame = readNumber<std::int16_t>(stream, revEndian);
-    endFrame = readNumber<std::int16_t>(stream, revEndian);
-    childBinding = readNumber<std::uint8_t>(stream, revEndian);
+    animationOrder = readNumber<std::uint16_t, E>(stream);
+    auto groupCount = readNumber<std::uint16_t, E>(stream);
+    auto animNameOffset = readNumber<std::uint32_t, E>(stream);
+    auto groupNamesOffset = readNumber<std::uint32_t, E>(stream);
+    startFrame = readNumber<std::int16_t, E>(stream);
+    endFrame = readNumber<std::int16_t, E>(stream);
+    childBinding = readNumber<std::uint8_t, E>(stream);
     unknownData = readFixedStr(stream, startPos + std::streamoff(animNameOffset) - stream.tellg());
     
     stream.seekg(startPos + std::streamoff(animNameOffset));
     name = readNullTerminatedStr(stream);
 
     stream.seekg(startPos + std::streamoff(groupNamesOffset));
+    groups.reserve(groups.size() + groupCount);
     for (int i=0; i<groupCount; ++i) {
-        groups.push_back(readFixedStr(stream, 0x14));
+        groups.push_back(readFixedName<0x14>(stream));
     }
 }
 
-void Pat1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto startPos = stream.tellp() - std::streamoff(8);
-    writeNumber(animationOrder, stream, revEndian);
-    writeNumber((std::uint16_t)groups.size(), stream, revEndian);
-    auto animNameOffPos = stream.tellp();
-    writeNumber((std::uint32_t)0, stream, revEndian);
-    auto groupNamesOffPos = stream.tellp();
-    writeNumber((std::uint32_t)0, stream, revEndian);
-    writeNumber(startFrame, stream, revEndian);
-    writeNumber(endFrame, stream, revEndian);
-    writeNumber((std::uint8_t)childBinding, stream, revEndian);
+template<Endian E>
+void Pat1::write(BinaryWriter &stream, const BaseHeader &) {
+    // offsets are relative to the start of the section header
+    std::uint32_t animNameOffset = 8 + 0x11 + unknownData.size();
+    std::uint32_t groupNamesOffset = align4(animNameOffset + name.size() + 1);
+    writeNumber<E>(animationOrder, stream);
+    writeNumber<E>((std::uint16_t)groups.size(), stream);
+    writeNumber<E>(animNameOffset, stream);
+    writeNumber<E>(groupNamesOffset, stream);
+    writeNumber<E>(startFrame, stream);
+    writeNumber<E>(endFrame, stream);
+    writeNumber<E>((std::uint8_t)childBinding, stream);
     writeFixedStr(unknownData, stream, unknownData.size());
-    auto pos2 = stream.tellp();
-    {
-        TemporarySeekO ts(stream, animNameOffPos);
-        writeNumber(std::uint32_t(pos2 - startPos), stream, revEndian);
-    }
     writeNullTerminatedStr(name, stream);
-    alignFile(stream);
-    pos2 = stream.tellp();
-    {
-        TemporarySeekO ts(stream, groupNamesOffPos);
-        writeNumber(std::uint32_t(pos2 - startPos), stream, revEndian);
-    }
+    writePadding(stream, groupNamesOffset - (animNameOffset + name.size() + 1));
     for (auto &group: groups) {
-        writeFixedStr(group, stream, 0x14);
+        writeFixedName(group, stream);
     }
 }
 
-void PaiTag::read(std::istream &stream, bool revEndian, AnimationTarget target) {
+std::uint32_t Pat1::size(const BaseHeader &) {
+    std::uint32_t groupNamesOffset = align4(8 + 0x11 + unknownData.size() + name.size() + 1);
+    return groupNamesOffset - 8 + groups.size() * 0x14;
+}
+
+template<Endian E>
+void PaiTag::read(BinaryReader &stream, AnimationTarget target) {
     if (target == 2) {
-        unknown = readNumber<std::uint32_t>(stream, revEndian);
+        unknown = readNumber<std::uint32_t, E>(stream);
     }
     auto startPos = stream.tellg();
     tag = readFixedStr(stream, 4);
-    auto numEntries = readNumber<std::uint8_t>(stream, revEndian);
+    auto numEntries = readNumber<std::uint8_t, E>(stream);
     stream.seekg(3, std::ios::cur);
     tagEntries.resize(numEntries);
     for (auto &tagEntry: tagEntries) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
+        auto off = readNumber<std::uint32_t, E>(stream);
         {
             TemporarySeekI ts(stream, startPos + std::streamoff(off));
-            tagEntry.read(stream, revEndian);
+            tagEntry.read<E>(stream);
         }
     }
 }
 
-void PaiTag::write(std::ostream &stream, bool revEndian, AnimationTarget target) {
+template<Endian E>
+void PaiTag::write(BinaryWriter &stream, AnimationTarget target) {
     if (target == 2) {
-        writeNumber(unknown, stream, revEndian);
+        writeNumber<E>(unknown, stream);
     }
-    auto startPos = stream.tellp();
     writeFixedStr(tag, stream, 4);
-    writeNumber((std::uint8_t)tagEntries.size(), stream, revEndian);
+    writeNumber<E>((std::uint8_t)tagEntries.size(), stream);
     stream.write("\0\0\0", 3);
-    auto offStart = stream.tellp();
-    for (int i=0; i<tagEntries.size() * sizeof(std::uint32_t); ++i) {
-        stream.put('\0');
+    // offsets are relative to the tag name
+    std::uint32_t off = 8 + tagEntries.size() * sizeof(std::uint32_t);
+    for (auto &tagEntry: tagEntries) {
+        writeNumber<E>(off, stream);
+        off += tagEntry.size();
     }
-    auto pos2 = stream.tellp();
-    stream.seekp(offStart);
     for (auto &tagEntry: tagEntries) {
-        writeNumber(std::uint32_t(pos2 - startPos), stream, revEndian);
-        {
-            TemporarySeekO ts(stream, pos2);
-            tagEntry.write(stream, revEndian);
-            pos2 = stream.tellp();
-        }
+        tagEntry.write<E>(stream);
     }
-    stream.seekp(pos2); // seek to end of allocated stuff
 }
 
-void PaiEntry::read(std::istream &stream, bool revEndian) {
+std::uint32_t PaiTag::size(AnimationTarget target) const {
+    std::uint32_t size = (target == 2 ? 4 : 0) + 8 + tagEntries.size() * sizeof(std::uint32_t);
+    for (auto &tagEntry: tagEntries) {
+        size += tagEntry.size();
+    }
+    return size;
+}
+
+template<Endian E>
+void PaiEntry::read(BinaryReader &stream) {
     auto startPos = stream.tellg();
-    name = readFixedStr(stream, 0x14);
-    auto numTags = readNumber<std::uint8_t>(stream, revEndian);
-    target = (AnimationTarget)readNumber<std::uint8_t>(stream, revEndian);
+    name = readFixedName<0x14>(stream);
+    auto numTags = readNumber<std::uint8_t, E>(stream);
+    target = (AnimationTarget)readNumber<std::uint8_t, E>(stream);
     stream.seekg(2, std::ios::cur);
     tags.resize(numTags);
     for (auto &tag: tags) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
+        auto off = readNumber<std::uint32_t, E>(stream);
         {
             TemporarySeekI ts(stream, startPos + std::streamoff(off));
-            tag.read(stream, revEndian, target);
+            tag.read<E>(stream, target);
         }
     }
 }
 
-void PaiEntry::write(std::ostream &stream, bool revEndian) {
-    auto startPos = stream.tellp();
-    writeFixedStr(name, stream, 0x14);
-    writeNumber((std::uint8_t)tags.size(), stream, revEndian);
-    writeNumber((std::uint8_t)target, stream, revEndian);
+template<Endian E>
+void PaiEntry::write(BinaryWriter &stream) {
+    writeFixedName(name, stream);
+    writeNumber<E>((std::uint8_t)tags.size(), stream);
+    writeNumber<E>((std::uint8_t)target, stream);
     stream.put('\0');
     stream.put('\0');
-    auto offStart = stream.tellp();
-    for (int i=0; i<tags.size() * sizeof(std::uint32_t); ++i) {
-        stream.put('\0');
+    // offsets are relative to the start of the entry
+    std::uint32_t off = 0x18 + tags.size() * sizeof(std::uint32_t);
+    for (auto &tag: tags) {
+        writeNumber<E>(off, stream);
+        off += tag.size(target);
     }
-    auto pos2 = stream.tellp();
-    stream.seekp(offStart);
     for (auto &tag: tags) {
-        writeNumber(std::uint32_t(pos2 - startPos), stream, revEndian);
-        {
-            TemporarySeekO ts(stream, pos2);
-            tag.write(stream, revEndian, target);
-            pos2 = stream.tellp();
-        }
+        tag.write<E>(stream, target);
     }
-    stream.seekp(pos2); // seek to end of allocated stuff
 }
 
-void Pai1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+std::uint32_t PaiEntry::size() const {
+    std::uint32_t size = 0x18 + tags.size() * sizeof(std::uint32_t);
+    for (auto &tag: tags) {
+        size += tag.size(target);
+    }
+    return size;
+}
+
+template<Endian E>
+void Pai1::read(BinaryReader &stream, const BaseHeader &header) {
     auto startPos = stream.tellg() - std::streamoff(8);
-    frameSize = readNumber<std::uint16_t>(stream, revEndian);
-    loop = readNumber<std::uint8_t>(stream, revEndian);
+    frameSize = readNumber<std::uint16_t, E>(stream);
+    loop = readNumber<std::uint8_t, E>(stream);
     stream.seekg(1, std::ios::cur);
-    auto numTextures = readNumber<std::uint16_t>(stream, revEndian);
-    auto numEntries = readNumber<std::uint16_t>(stream, revEndian);
-    auto entryOffsetTbl = readNumber<std::uint32_t>(stream, revEndian);
+    auto numTextures = readNumber<std::uint16_t, E>(stream);
+    auto numEntries = readNumber<std::uint16_t, E>(stream);
+    auto entryOffsetTbl = readNumber<std::uint32_t, E>(stream);
+    textures.reserve(textures.size() + numTextures);
     for (int i=0; i<numTextures; ++i) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
+        auto off = readNumber<std::uint32_t, E>(stream);
         {
             TemporarySeekI ts(stream, startPos + std::streamoff(off));
-            textures.push_back(readNullTerminatedStr(stream));
+            textures.emplace_back(readNullTerminatedStrView(stream));
         }
     }
     stream.seekg(startPos + std::streamoff(entryOffsetTbl));
+    std::vector<std::uint32_t> offsets(numEntries);
+    readArray<E>(stream, offsets.data(), offsets.size());
     entries.resize(numEntries);
-    for (auto &entry: entries) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
-        {
-            TemporarySeekI ts(stream, startPos + std::streamoff(off));
-            entry.read(stream, revEndian);
-        }
+    // entries are self-contained, so each one is decoded into its slot through its own reader
+    parallelFor(numEntries, header.readOptions.threads, [&](std::size_t i) {
+        BinaryReader reader(stream.data(), stream.size());
+        reader.seekg(startPos + std::streamoff(offsets[i]));
+        entries[i].read<E>(reader);
+    });
+}
+
+static std::uint32_t entryOffsetTblOffset(const std::vector<std::string> &textures) {
+    std::uint32_t off = 8 + 0xc + textures.size() * sizeof(std::uint32_t);
+    for (auto &tex: textures) {
+        off += tex.size() + 1;
     }
+    return align4(off);
 }
 
-void Pai1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto startPos = stream.tellp() - std::streamoff(8);
-    writeNumber(frameSize, stream, revEndian);
-    writeNumber((std::uint8_t)loop, stream, revEndian);
+template<Endian E>
+void Pai1::write(BinaryWriter &stream, const BaseHeader &) {
+    // offsets are relative to the start of the section header
+    std::uint32_t entryOffsetTbl = entryOffsetTblOffset(textures);
+    writeNumber<E>(frameSize, stream);
+    writeNumber<E>((std::uint8_t)loop, stream);
     stream.put('\0');
-    writeNumber((std::uint16_t)textures.size(), stream, revEndian);
-    writeNumber((std::uint16_t)entries.size(), stream, revEndian);
-    auto entryOffsetTblPos = stream.tellp();
-    writeNumber(std::uint32_t(0), stream, revEndian);
+    writeNumber<E>((std::uint16_t)textures.size(), stream);
+    writeNumber<E>((std::uint16_t)entries.size(), stream);
+    writeNumber<E>(entryOffsetTbl, stream);
 
     // write texture offsets and strings
-    auto offStart = stream.tellp();
-    for (int i=0; i<textures.size() * sizeof(std::uint32_t); ++i) {
-        stream.put('\0');
+    std::uint32_t off = 8 + 0xc + textures.size() * sizeof(std::uint32_t);
+    for (auto &tex: textures) {
+        writeNumber<E>(off, stream);
+        off += tex.size() + 1;
     }
-    auto pos2 = stream.tellp();
-    stream.seekp(offStart);
     for (auto &tex: textures) {
-        writeNumber(std::uint32_t(pos2 - startPos), stream, revEndian);
-        {
-            TemporarySeekO ts(stream, pos2);
-            writeNullTerminatedStr(tex, stream);
-            pos2 = stream.tellp();
-        }
+        writeNullTerminatedStr(tex, stream);
     }
-
-    stream.seekp(pos2); // seek to end of allocated textures
-    alignFile(stream);
+    writePadding(stream, entryOffsetTbl - off);
 
     // write entries
-    offStart = stream.tellp();
-    {
-        TemporarySeekO ts(stream, entryOffsetTblPos);
-        // write entry offset position
-        writeNumber(std::uint32_t(offStart - startPos), stream, revEndian);
-    }
-    for (int i=0; i<entries.size() * sizeof(std::uint32_t); ++i) {
-        stream.put('\0');
+    off = entryOffsetTbl + entries.size() * sizeof(std::uint32_t);
+    for (auto &entry: entries) {
+        writeNumber<E>(off, stream);
+        off += entry.size();
     }
-    pos2 = stream.tellp();
-    stream.seekp(offStart);
     for (auto &entry: entries) {
-        writeNumber(std::uint32_t(pos2 - startPos), stream, revEndian);
-        {
-            TemporarySeekO ts(stream, pos2);
-            entry.write(stream, revEndian);
-            pos2 = stream.tellp();
-        }
+        entry.write<E>(stream);
     }
+}
 
-    stream.seekp(pos2); // seek to end of allocated entries
+std::uint32_t Pai1::size(const BaseHeader &) {
+    std::uint32_t size = entryOffsetTblOffset(textures) - 8 + entries.size() * sizeof(std::uint32_t);
+    for (auto &entry: entries) {
+        size += entry.size();
+    }
+    return size;
 }
 
 void Brlan::read(std::istream &stream) {
-    auto magic = readFixedStr(stream, 4);
-    bool reverseEndian;
-    if (magic != MAGIC) {
-        // TODO throw exception here
-    }
-    bom = readNumber<std::uint16_t>(stream, false);
-    reverseEndian = revEndian();
-    version = readNumber<std::uint16_t>(stream, reverseEndian);
-    auto fileSize = readNumber<std::uint32_t>(stream, reverseEndian);
-    headerSize = readNumber<std::uint16_t>(stream, reverseEndian);
-    auto sectionCount = readNumber<std::uint16_t>(stream, reverseEndian);
+    auto buffer = readAll(stream);
+    read(buffer.data(), buffer.size());
+}
+
+void Brlan::read(const char *data, std::size_t size) {
+    BinaryReader reader(data, size);
+    read(reader);
+}
+
+void Brlan::read(BinaryReader &stream) {
+    auto sectionCount = readFileHeader(stream, MAGIC);
 
     stream.seekg(headerSize);
 
-    for (int i=0; i<sectionCount; ++i) {
-        auto pos = stream.tellg();
+    // the byte order is checked once here, so every section below reads without branching on it
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        for (int i=0; i<sectionCount; ++i) {
+            auto pos = stream.tellg();
+
+            auto sectionMagic = readNumber<std::uint32_t, Endian::Big>(stream);
+            auto sectionSize = readNumber<std::uint32_t, E>(stream);
+            SectionTimer timer(observer, sectionMagic, false, sectionSize);
+
+            switch (sectionMagic) {
+            case Pat1::FOURCC:
+                animationTag.read<E>(stream, *this);
+                break;
+            case Pai1::FOURCC:
+                animationInfo.read<E>(stream, *this);
+                break;
+            }
 
-        auto sectionHeader = readFixedStr(stream, 4);
-        auto sectionSize = readNumber<std::uint32_t>(stream, reverseEndian);
+            stream.seekg(pos + std::streamoff(sectionSize));
+        }
+    });
+}
+
+std::vector<SectionEntry> Brlan::scan(BinaryReader &stream) {
+    return scanSections(stream, MAGIC);
+}
 
-        if (sectionHeader == Pat1::MAGIC) {
-            animationTag.read(stream, *this);
-        } else if (sectionHeader == Pai1::MAGIC) {
-            animationInfo.read(stream, *this);
+void Brlan::readSection(BinaryReader &stream, const SectionEntry &entry) {
+    stream.seekg(entry.offset + 8);
+    SectionTimer timer(observer, entry.magic, false, entry.size);
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        switch (entry.magic) {
+        case Pat1::FOURCC:
+            animationTag.groups.clear();
+            animationTag.read<E>(stream, *this);
+            break;
+        case Pai1::FOURCC:
+            animationInfo.textures.clear();
+            animationInfo.read<E>(stream, *this);
+            break;
         }
+    });
+}
 
-        stream.seekg(pos + std::streamoff(sectionSize));
-    }
+void Brlan::loadFile(const std::string &path) {
+    MappedFile file(path);
+    read(file.data(), file.size());
 }
 
 void Brlan::write(std::ostream &stream) {
-    writeFixedStr(MAGIC, stream, 4);
-    bool reverseEndian = (bom != 0xfeff);
-    writeNumber(bom, stream, false);
-    writeNumber((std::uint16_t)version, stream, reverseEndian);
-    auto fileSizePos = stream.tellp();
-    writeNumber(std::uint32_t(0), stream, reverseEndian);
-    // header size
-    writeNumber(std::uint16_t(stream.tellp() + std::streamoff(4)), stream, reverseEndian);
-    // section count
-    writeNumber(std::uint16_t(2), stream, reverseEndian);
+    auto buffer = serialize();
+    stream.write(buffer.data(), buffer.size());
+}
 
-    writeSection(Pat1::MAGIC, animationTag, stream, *this);
-    writeSection(Pai1::MAGIC, animationInfo, stream, *this);
+std::vector<char> Brlan::serialize() {
+    BinaryWriter writer;
+    write(writer);
+    return writer.release();
+}
 
-    alignFile(stream);
+void Brlan::write(BinaryWriter &stream) {
+    // size everything up front so that the file is written strictly forward
+    std::uint32_t fileSize = 0x10 + sectionSize(animationTag, *this) + sectionSize(animationInfo, *this);
 
-    auto fileEnd = stream.tellp();
+    stream.reserve(stream.size() + fileSize);
+    writeFixedStr(MAGIC, stream, 4);
+    writeNumber(bom, stream, false);
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        writeNumber<E>((std::uint16_t)version, stream);
+        writeNumber<E>(fileSize, stream);
+        // header size
+        writeNumber<E>(std::uint16_t(0x10), stream);
+        // section count
+        writeNumber<E>(std::uint16_t(2), stream);
 
-    {
-        TemporarySeekO ts(stream, fileSizePos);
-        writeNumber((std::uint32_t)fileEnd, stream, reverseEndian);
-    }
+        writeSection<E>(Pat1::MAGIC, animationTag, stream, *this);
+        writeSection<E>(Pai1::MAGIC, animationInfo, stream, *this);
+    });
 }
 
+// the members code outside this file reads and writes single records with
+template void PaiEntry::read<Endian::Big>(BinaryReader &stream);
+template void PaiEntry::read<Endian::Little>(BinaryReader &stream);
+template void PaiEntry::write<Endian::Big>(BinaryWriter &stream);
+template void PaiEntry::write<Endian::Little>(BinaryWriter &stream);
+
 }
@@ -6,35 +6,78 @@
 namespace bq::brlan {
 
 struct Pat1 : BasePat1 {
-    static inline const std::string MAGIC = "pat1";
+    static constexpr std::string_view MAGIC = "pat1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     std::string unknownData;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 struct PaiTag : BasePaiTag {
     std::uint32_t unknown;
-    void read(std::istream &stream, bool revEndian, AnimationTarget target);
-    void write(std::ostream &stream, bool revEndian, AnimationTarget target);
+    template<Endian E>
+    void read(BinaryReader &stream, AnimationTarget target);
+    template<Endian E>
+    void write(BinaryWriter &stream, AnimationTarget target);
+    std::uint32_t size(AnimationTarget target) const;
 };
 
 struct PaiEntry : BasePaiEntry<PaiTag> {
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
+    std::uint32_t size() const;
 };
 
 struct Pai1 : BasePai1<PaiEntry> {
-    static inline const std::string MAGIC = "pai1";
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    static constexpr std::string_view MAGIC = "pai1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 struct Brlan : BaseHeader {
-    static inline const std::string MAGIC = "RLAN";
+    static constexpr std::string_view MAGIC = "RLAN";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     Pat1 animationTag;
     Pai1 animationInfo;
+    /**
+     * @brief reads the file from the current position of the stream to its end
+     */
     void read(std::istream &stream);
+    /**
+     * @brief reads the file from a buffer that is already in memory
+     */
+    void read(const char *data, std::size_t size);
+    void read(BinaryReader &stream);
+    /**
+     * @brief reads the file header and lists the sections without decoding them
+     */
+    std::vector<SectionEntry> scan(BinaryReader &stream);
+    /**
+     * @brief decodes the pat1 or pai1 section at a directory entry
+     *
+     * The section replaces what was read into it before, so reading it twice
+     * does not duplicate its groups or textures.
+     */
+    void readSection(BinaryReader &stream, const SectionEntry &entry);
+    /**
+     * @brief memory-maps the file at path read-only and parses it in place
+     */
+    void loadFile(const std::string &path);
     void write(std::ostream &stream);
+    void write(BinaryWriter &stream);
+    /**
+     * @brief serializes the file into a single buffer of exactly its size
+     */
+    std::vector<char> serialize();
 };
 
 }
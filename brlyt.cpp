@@ -2,294 +2,405 @@
 
 namespace bq::brlyt {
 
-void Lyt1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    drawFromCenter = readNumber<std::uint8_t>(stream, revEndian);
+template<Endian E>
+void Lyt1::read(BinaryReader &stream, const BaseHeader &) {
+    drawFromCenter = readNumber<std::uint8_t, E>(stream);
     stream.seekg(3, std::ios::cur); // padding
-    width = readNumber<float>(stream, revEndian);
-    height = readNumber<float>(stream, revEndian);
+    width = readNumber<float, E>(stream);
+    height = readNumber<float, E>(stream);
 }
 
-void Lyt1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    writeNumber(drawFromCenter, stream, revEndian);
+template<Endian E>
+void Lyt1::write(BinaryWriter &stream, const BaseHeader &) {
+    writeNumber<E>(drawFromCenter, stream);
     stream.write("\0\0\0", 3);
-    writeNumber(width, stream, revEndian);
-    writeNumber(height, stream, revEndian);
+    writeNumber<E>(width, stream);
+    writeNumber<E>(height, stream);
 }
 
-void TexCoordGenEntry::read(std::istream &stream, bool revEndian) {
-    type = (TexCoordGenTypes)readNumber<std::uint8_t>(stream, revEndian);
-    source = (TexCoordGenSource)readNumber<std::uint8_t>(stream, revEndian);
-    matrixSource = (TexCoordGenMatrixSource)readNumber<std::uint8_t>(stream, revEndian);
-    unknown = readNumber<std::uint8_t>(stream, revEndian);
+std::uint32_t Lyt1::size(const BaseHeader &) {
+    return 0xc;
 }
 
-void TexCoordGenEntry::write(std::ostream &stream, bool revEndian) {
-    writeNumber((std::uint8_t)type, stream, revEndian);
-    writeNumber((std::uint8_t)source, stream, revEndian);
-    writeNumber((std::uint8_t)matrixSource, stream, revEndian);
-    writeNumber((std::uint8_t)unknown, stream, revEndian);
+template<Endian E>
+void TexCoordGenEntry::read(BinaryReader &stream) {
+    type = (TexCoordGenTypes)readNumber<std::uint8_t, E>(stream);
+    source = (TexCoordGenSource)readNumber<std::uint8_t, E>(stream);
+    matrixSource = (TexCoordGenMatrixSource)readNumber<std::uint8_t, E>(stream);
+    unknown = readNumber<std::uint8_t, E>(stream);
 }
 
-void ChanCtrl::read(std::istream &stream, bool revEndian) {
-    colorMatSource = readNumber<std::uint8_t>(stream, revEndian);
-    alphaMatSource = readNumber<std::uint8_t>(stream, revEndian);
-    unknown1 = readNumber<std::uint8_t>(stream, revEndian);
-    unknown2 = readNumber<std::uint8_t>(stream, revEndian);
+template<Endian E>
+void TexCoordGenEntry::write(BinaryWriter &stream) {
+    writeNumber<E>((std::uint8_t)type, stream);
+    writeNumber<E>((std::uint8_t)source, stream);
+    writeNumber<E>((std::uint8_t)matrixSource, stream);
+    writeNumber<E>((std::uint8_t)unknown, stream);
 }
 
-void ChanCtrl::write(std::ostream &stream, bool revEndian) {
-    writeNumber(colorMatSource, stream, revEndian);
-    writeNumber(alphaMatSource, stream, revEndian);
-    writeNumber(unknown1, stream, revEndian);
-    writeNumber(unknown2, stream, revEndian);
+template<Endian E>
+void ChanCtrl::read(BinaryReader &stream) {
+    colorMatSource = readNumber<std::uint8_t, E>(stream);
+    alphaMatSource = readNumber<std::uint8_t, E>(stream);
+    unknown1 = readNumber<std::uint8_t, E>(stream);
+    unknown2 = readNumber<std::uint8_t, E>(stream);
 }
 
-void SwapMode::read(std::istream &stream, bool revEndian) {
-    auto val = readNumber<std::uint8_t>(stream, revEndian);
+template<Endian E>
+void ChanCtrl::write(BinaryWriter &stream) {
+    writeNumber<E>(colorMatSource, stream);
+    writeNumber<E>(alphaMatSource, stream);
+    writeNumber<E>(unknown1, stream);
+    writeNumber<E>(unknown2, stream);
+}
+
+template<Endian E>
+void SwapMode::read(BinaryReader &stream) {
+    auto val = readNumber<std::uint8_t, E>(stream);
     r = SwapChannel(val & 0x3);
     g = SwapChannel((val >> 2) & 0x3);
     b = SwapChannel((val >> 4) & 0x3);
     a = SwapChannel((val >> 6) & 0x3);
 }
 
-void SwapMode::write(std::ostream &stream, bool revEndian) {
+template<Endian E>
+void SwapMode::write(BinaryWriter &stream) {
     std::uint8_t val = r + (g << 2) + (b << 4) + (a << 6);
-    writeNumber(val, stream, revEndian);
+    writeNumber<E>(val, stream);
 }
 
-void TevSwapModeTable::read(std::istream &stream, bool revEndian) {
+template<Endian E>
+void TevSwapModeTable::read(BinaryReader &stream) {
     for (auto &swapMode: swapModes) {
-        swapMode.read(stream, revEndian);
+        swapMode.read<E>(stream);
     }
 }
 
-void TevSwapModeTable::write(std::ostream &stream, bool revEndian) {
+template<Endian E>
+void TevSwapModeTable::write(BinaryWriter &stream) {
     for (auto &swapMode: swapModes) {
-        swapMode.write(stream, revEndian);
+        swapMode.write<E>(stream);
     }
 }
 
-void IndirectStage::read(std::istream &stream, bool revEndian) {
-    texCoord = readNumber<std::uint8_t>(stream, revEndian);
-    texMap = readNumber<std::uint8_t>(stream, revEndian);
-    scaleS = readNumber<std::uint8_t>(stream, revEndian);
-    scaleT = readNumber<std::uint8_t>(stream, revEndian);
+template<Endian E>
+void IndirectStage::read(BinaryReader &stream) {
+    texCoord = readNumber<std::uint8_t, E>(stream);
+    texMap = readNumber<std::uint8_t, E>(stream);
+    scaleS = readNumber<std::uint8_t, E>(stream);
+    scaleT = readNumber<std::uint8_t, E>(stream);
 }
 
-void IndirectStage::write(std::ostream &stream, bool revEndian) {
-    writeNumber(texCoord, stream, revEndian);
-    writeNumber(texMap, stream, revEndian);
-    writeNumber(scaleS, stream, revEndian);
-    writeNumber(scaleT, stream, revEndian);
+template<Endian E>
+void IndirectStage::write(BinaryWriter &stream) {
+    writeNumber<E>(texCoord, stream);
+    writeNumber<E>(texMap, stream);
+    writeNumber<E>(scaleS, stream);
+    writeNumber<E>(scaleT, stream);
 }
 
-void TextureRef::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto id = readNumber<std::uint16_t>(stream, revEndian);
+template<Endian E>
+void TextureRef::read(BinaryReader &stream, const BaseHeader &header) {
+    auto id = readNumber<std::uint16_t, E>(stream);
     name = static_cast<const Brlyt &>(header).txl1.textures[id];
-    wrapModeU = (WrapMode)readNumber<std::uint8_t>(stream, revEndian);
-    wrapModeV = (WrapMode)readNumber<std::uint8_t>(stream, revEndian);
+    wrapModeU = (WrapMode)readNumber<std::uint8_t, E>(stream);
+    wrapModeV = (WrapMode)readNumber<std::uint8_t, E>(stream);
     filterModeMin = filterModeMax = FilterMode::Linear;
 }
 
-void TextureRef::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto &textures = static_cast<const Brlyt &>(header).txl1.textures;
-    std::uint16_t id = std::find(textures.begin(), textures.end(), name) - textures.begin();
-    writeNumber(id, stream, revEndian);
-    writeNumber((std::uint8_t)wrapModeU, stream, revEndian);
-    writeNumber((std::uint8_t)wrapModeV, stream, revEndian);
+template<Endian E>
+void TextureRef::write(BinaryWriter &stream, const BaseHeader &header) {
+    std::uint16_t id = static_cast<const Brlyt &>(header).textureIndex(name);
+    writeNumber<E>(id, stream);
+    writeNumber<E>((std::uint8_t)wrapModeU, stream);
+    writeNumber<E>((std::uint8_t)wrapModeV, stream);
 }
 
-void TevStage::read(std::istream &stream, bool revEndian) {
-    texCoord = readNumber<std::uint8_t>(stream, revEndian);
-    color = readNumber<std::uint8_t>(stream, revEndian);
-    flag1 = readNumber<std::uint16_t>(stream, revEndian);
+template<Endian E>
+void TevStage::read(BinaryReader &stream) {
+    texCoord = readNumber<std::uint8_t, E>(stream);
+    color = readNumber<std::uint8_t, E>(stream);
+    flag1 = readNumber<std::uint16_t, E>(stream);
     for (auto &flag: flags) {
-        flag = readNumber<std::uint8_t>(stream, revEndian);
+        flag = readNumber<std::uint8_t, E>(stream);
     }
 }
 
-void TevStage::write(std::ostream &stream, bool revEndian) {
-    writeNumber(texCoord, stream, revEndian);
-    writeNumber(color, stream, revEndian);
-    writeNumber(flag1, stream, revEndian);
+template<Endian E>
+void TevStage::write(BinaryWriter &stream) {
+    writeNumber<E>(texCoord, stream);
+    writeNumber<E>(color, stream);
+    writeNumber<E>(flag1, stream);
     for (auto flag: flags) {
-        writeNumber(flag, stream, revEndian);
+        writeNumber<E>(flag, stream);
     }
 }
 
-void AlphaCompare::read(std::istream &stream, bool revEndian) {
-    auto c = readNumber<std::uint8_t>(stream, revEndian);
+template<Endian E>
+void AlphaCompare::read(BinaryReader &stream) {
+    auto c = readNumber<std::uint8_t, E>(stream);
     comp0 = AlphaFunction(c & 0x7);
     comp1 = AlphaFunction((c >> 4) & 0x7);
-    op = (AlphaOp)readNumber<std::uint8_t>(stream, revEndian);
-    ref0 = readNumber<std::uint8_t>(stream, revEndian);
-    ref1 = readNumber<std::uint8_t>(stream, revEndian);
+    op = (AlphaOp)readNumber<std::uint8_t, E>(stream);
+    ref0 = readNumber<std::uint8_t, E>(stream);
+    ref1 = readNumber<std::uint8_t, E>(stream);
 }
 
-void AlphaCompare::write(std::ostream &stream, bool revEndian) {
+template<Endian E>
+void AlphaCompare::write(BinaryWriter &stream) {
     std::uint8_t c = std::uint8_t(comp0) + (std::uint8_t(comp1) << 4);
-    writeNumber(c, stream, revEndian);
-    writeNumber((std::uint8_t)op, stream, revEndian);
-    writeNumber(ref0, stream, revEndian);
-    writeNumber(ref1, stream, revEndian);
+    writeNumber<E>(c, stream);
+    writeNumber<E>((std::uint8_t)op, stream);
+    writeNumber<E>(ref0, stream);
+    writeNumber<E>(ref1, stream);
 }
 
-void Material::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+template<Endian E>
+void Material::read(BinaryReader &stream, const BaseHeader &header) {
+    name = readFixedName<0x14>(stream);
+    readColors<E>(stream);
+    flags = readNumber<std::uint32_t, E>(stream);
+    textureMaps.resize(texCount());
+    for (auto &textureMap: textureMaps) {
+        textureMap.read<E>(stream, header);
+    }
+    readStages<E>(stream);
+}
 
-    name = readFixedStr(stream, 0x14);
-    blackColor = toColor8(readColor16(stream, revEndian));
-    whiteColor = toColor8(readColor16(stream, revEndian));
-    colorRegister3 = toColor8(readColor16(stream, revEndian));
+template<Endian E>
+void Material::readColors(BinaryReader &stream) {
+    blackColor = toColor8(readColor16<E>(stream));
+    whiteColor = toColor8(readColor16<E>(stream));
+    colorRegister3 = toColor8(readColor16<E>(stream));
     for (auto &tevColor: tevColors) {
-        tevColor = readColor8(stream, revEndian);
-    }
-    flags = readNumber<std::uint32_t>(stream, revEndian);
-    textureMaps.resize(texCount);
-    for (auto &textureMap: textureMaps) {
-        textureMap.read(stream, header);
+        tevColor = readColor8<E>(stream);
     }
-    texTransforms.resize(mtxCount);
+}
+
+template<Endian E>
+void Material::readStages(BinaryReader &stream) {
+    texTransforms.resize(mtxCount());
     for (auto &texTransform: texTransforms) {
-        texTransform.read(stream, revEndian);
+        texTransform.read<E>(stream);
     }
-    texCoordGens.resize(texCoordGenCount);
+    texCoordGens.resize(texCoordGenCount());
     for (auto &texCoordGen: texCoordGens) {
-        texCoordGen.read(stream, revEndian);
+        texCoordGen.read<E>(stream);
     }
-    if (hasChannelControl) {
-        chanCtrl.read(stream, revEndian);
+    if (hasChannelControl()) {
+        chanCtrl.read<E>(stream);
     }
-    if (hasMaterialColor) {
-        matColor = readColor8(stream, revEndian);
+    if (hasMaterialColor()) {
+        matColor = readColor8<E>(stream);
     }
-    if (hasTevSwapTable) {
-        swapModeTable.read(stream, revEndian);
+    if (hasTevSwapTable()) {
+        swapModeTable.read<E>(stream);
     }
-    indirectTransforms.resize(indSrtCount);
+    indirectTransforms.resize(indSrtCount());
     for (auto &indTransform: indirectTransforms) {
-        indTransform.read(stream, revEndian);
+        indTransform.read<E>(stream);
     }
-    indirectStages.resize(indTexOrderCount);
+    indirectStages.resize(indTexOrderCount());
     for (auto &indStage: indirectStages) {
-        indStage.read(stream, revEndian);
+        indStage.read<E>(stream);
     }
-    tevStages.resize(tevStagesCount);
+    tevStages.resize(tevStagesCount());
     for (auto &tevStage: tevStages) {
-        tevStage.read(stream, revEndian);
+        tevStage.read<E>(stream);
     }
-    if (hasAlphaCompare) {
-        alphaCompare.read(stream, revEndian);
+    if (hasAlphaCompare()) {
+        alphaCompare.read<E>(stream);
     }
-    if (hasBlendMode) {
-        blendMode.read(stream, revEndian);
+    if (hasBlendMode()) {
+        blendMode.read<E>(stream);
     }
 }
 
-void Material::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+template<Endian E>
+void Material::readLazy(BinaryReader &stream, const BaseHeader &header) {
+    auto start = stream.tellg();
+    name = readFixedName<0x14>(stream);
+    // the flags follow the name, three color16 and four color8 values
+    stream.seekg(start + std::streamoff(0x3c));
+    flags = readNumber<std::uint32_t, E>(stream);
+    // texture names come from txl1, so resolve them now and let decode work without the header
+    textureMaps.resize(texCount());
+    for (auto &textureMap: textureMaps) {
+        textureMap.read<E>(stream, header);
+    }
+    // the flags determine the encoded size
+    std::uint32_t matSize = 0x14 + 3 * 8 + 4 * 4 + 4;
+    matSize += texCount() * 4 + mtxCount() * 0x14 + texCoordGenCount() * 4;
+    matSize += (hasChannelControl() + hasMaterialColor() + hasTevSwapTable()) * 4;
+    matSize += indSrtCount() * 0x14 + indTexOrderCount() * 4 + tevStagesCount() * 0x10;
+    matSize += (hasAlphaCompare() + hasBlendMode()) * 4;
+    stream.seekg(start);
+    auto data = static_cast<char *>(header.arena->allocate(matSize, 1));
+    stream.read(data, matSize);
+    encoded = std::string_view(data, matSize);
+    encodedArena = header.arena;
+    encodedRevEndian = E != NATIVE_ENDIAN;
+}
+
+void Material::decode() {
+    if (encoded.empty()) {
+        return;
+    }
+    BinaryReader reader(encoded.data(), encoded.size());
+    withEndian(encodedRevEndian, [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        reader.seekg(0x14);
+        readColors<E>(reader);
+        reader.seekg(0x40 + std::streamoff(textureMaps.size() * 4));
+        readStages<E>(reader);
+    });
+    encoded = {};
+    encodedArena.reset();
+}
 
-    writeFixedStr(name, stream, 0x14);
-    writeColor16(toColor16(blackColor), stream, revEndian);
-    writeColor16(toColor16(whiteColor), stream, revEndian);
-    writeColor16(toColor16(colorRegister3), stream, revEndian);
+template<Endian E>
+void Material::write(BinaryWriter &stream, const BaseHeader &header) {
+    if (!encoded.empty()) {
+        if (encodedRevEndian != (E != NATIVE_ENDIAN)) {
+            throw std::logic_error("material " + name.str() + " must be decoded before changing the byte order");
+        }
+        writeFixedName(name, stream);
+        stream.write(encoded.data() + 0x14, encoded.size() - 0x14);
+        return;
+    }
+
+    writeFixedName(name, stream);
+    writeColor16<E>(toColor16(blackColor), stream);
+    writeColor16<E>(toColor16(whiteColor), stream);
+    writeColor16<E>(toColor16(colorRegister3), stream);
     for (auto &tevColor: tevColors) {
-        writeColor8(tevColor, stream, revEndian);
+        writeColor8<E>(tevColor, stream);
     }
     // update flag
-    texCount = textureMaps.size();
-    mtxCount = texTransforms.size();
-    texCoordGenCount = texCoordGens.size();
-    indSrtCount = indirectTransforms.size();
-    indTexOrderCount = indirectStages.size();
-    tevStagesCount = tevStages.size();
+    setTexCount(textureMaps.size());
+    setMtxCount(texTransforms.size());
+    setTexCoordGenCount(texCoordGens.size());
+    setIndSrtCount(indirectTransforms.size());
+    setIndTexOrderCount(indirectStages.size());
+    setTevStagesCount(tevStages.size());
     // write the flag integer
-    writeNumber(flags, stream, revEndian);
+    writeNumber<E>(flags, stream);
 
     for (auto &textureMap: textureMaps) {
-        textureMap.write(stream, header);
+        textureMap.write<E>(stream, header);
     }
     for (auto &texTransform: texTransforms) {
-        texTransform.write(stream, revEndian);
+        texTransform.write<E>(stream);
     }
     for (auto &texCoordGen: texCoordGens) {
-        texCoordGen.write(stream, revEndian);
+        texCoordGen.write<E>(stream);
     }
-    if (hasChannelControl) {
-        chanCtrl.write(stream, revEndian);
+    if (hasChannelControl()) {
+        chanCtrl.write<E>(stream);
     }
     //std::cout << std::hex << stream.tellp() << std::endl;
-    if (hasMaterialColor) {
-        writeColor8(matColor, stream, revEndian);
+    if (hasMaterialColor()) {
+        writeColor8<E>(matColor, stream);
     }
     //std::cout << std::hex << stream.tellp() << std::endl;
-    if (hasTevSwapTable) {
-        swapModeTable.write(stream, revEndian);
+    if (hasTevSwapTable()) {
+        swapModeTable.write<E>(stream);
     }
     for (auto &indTransform: indirectTransforms) {
-        indTransform.write(stream, revEndian);
+        indTransform.write<E>(stream);
     }
     for (auto &indStage: indirectStages) {
-        indStage.write(stream, revEndian);
+        indStage.write<E>(stream);
     }
     for (auto &tevStage: tevStages) {
-        tevStage.write(stream, revEndian);
+        tevStage.write<E>(stream);
     }
-    if (hasAlphaCompare) {
-        alphaCompare.write(stream, revEndian);
+    if (hasAlphaCompare()) {
+        alphaCompare.write<E>(stream);
     }
-    if (hasBlendMode) {
-        blendMode.write(stream, revEndian);
+    if (hasBlendMode()) {
+        blendMode.write<E>(stream);
     }
 }
 
-void Mat1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+std::uint32_t Material::size() const {
+    if (!encoded.empty()) {
+        return encoded.size();
+    }
+    // name, color registers, tev colors and flags
+    std::uint32_t size = 0x14 + 3 * 8 + 4 * 4 + 4;
+    size += textureMaps.size() * 4;
+    size += texTransforms.size() * 0x14;
+    size += texCoordGens.size() * 4;
+    if (hasChannelControl()) size += 4;
+    if (hasMaterialColor()) size += 4;
+    if (hasTevSwapTable()) size += 4;
+    size += indirectTransforms.size() * 0x14;
+    size += indirectStages.size() * 4;
+    size += tevStages.size() * 0x10;
+    if (hasAlphaCompare()) size += 4;
+    if (hasBlendMode()) size += 4;
+    return size;
+}
+
+template<Endian E>
+void Mat1::read(BinaryReader &stream, const BaseHeader &header) {
     auto pos = stream.tellg();
-    auto numMats = readNumber<std::uint16_t>(stream, revEndian);
+    auto numMats = readNumber<std::uint16_t, E>(stream);
     stream.seekg(2, std::ios::cur); // padding
+    std::vector<std::uint32_t> offsets(numMats);
+    readArray<E>(stream, offsets.data(), offsets.size());
+    // the arena is not thread-safe, so every material is allocated up front
+    auto first = materials.size();
+    materials.reserve(first + numMats);
     for (int i=0; i<numMats; ++i) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
-        {
-            TemporarySeekI ts(stream, pos + std::streamoff(off - 8));
-            materials.push_back(std::make_shared<Material>());
-            materials.back()->read(stream, header);
+        materials.push_back(makeShared<Material>(header.arena));
+    }
+    // lazy materials keep their bytes in the arena, so they need one and stay serial
+    if (header.readOptions.lazyMaterials && header.arena) {
+        for (int i=0; i<numMats; ++i) {
+            TemporarySeekI ts(stream, pos + std::streamoff(offsets[i] - 8));
+            materials[first + i].get()->readLazy<E>(stream, header);
         }
+        return;
     }
+    // materials are independent records, so each one gets its own reader over the buffer
+    parallelFor(numMats, header.readOptions.threads, [&](std::size_t i) {
+        BinaryReader reader(stream.data(), stream.size());
+        reader.seekg(pos + std::streamoff(offsets[i] - 8));
+        materials[first + i]->read<E>(reader, header);
+    });
 }
 
-void Mat1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto pos = stream.tellp() - std::streamoff(8);
-    writeNumber((std::uint16_t)materials.size(), stream, revEndian);
+template<Endian E>
+void Mat1::write(BinaryWriter &stream, const BaseHeader &header) {
+    writeNumber<E>((std::uint16_t)materials.size(), stream);
     stream.put('\0');
     stream.put('\0');
-    std::streamoff firstOff = materials.size() * sizeof(uint32_t);
-    auto offsetStartPos = stream.tellp();
-    auto pos2 = offsetStartPos + firstOff;
-    for (int i=0; i<firstOff; ++i) {
-        stream.put('\0');
+    // offsets are relative to the start of the section header
+    std::uint32_t off = 8 + 4 + materials.size() * sizeof(std::uint32_t);
+    // get() so untouched lazy materials are copied without decoding them
+    for (auto &mat: materials) {
+        writeNumber<E>(off, stream);
+        off += align4(mat.get()->size());
     }
-    stream.seekp(offsetStartPos);
     for (auto &mat: materials) {
-        writeNumber(std::uint32_t(pos2 - pos), stream, revEndian);
+        auto matSize = mat.get()->size();
+        mat.get()->write<E>(stream, header);
+        writePadding(stream, align4(matSize) - matSize);
+    }
+}
 
-        {
-            TemporarySeekO ts(stream, pos2);
-            mat->write(stream, header);
-            alignFile(stream);
-            pos2 = stream.tellp();
-        }
+std::uint32_t Mat1::size(const BaseHeader &) {
+    std::uint32_t size = 4 + materials.size() * sizeof(std::uint32_t);
+    for (auto &mat: materials) {
+        size += align4(mat.get()->size());
     }
-    stream.seekp(pos2); // seek to end of allocated materials
+    return size;
 }
 
 #if 0
-void UsdEntry::read(std::istream &stream, bool revEndian) {
+void UsdEntry::read(BinaryReader &stream, bool revEndian) {
     auto pos = stream.tellg();
     auto nameOffset = readNumber<std::uint32_t>(stream, revEndian);
     auto dataOffset = readNumber<std::uint32_t>(stream, revEndian);
@@ -373,323 +484,333 @@ void UsdEntry::write(std::ostream &stream, bool revEndian) {
 }
 #endif
 
-void Usd1::read(std::istream &stream, const BaseHeader &header) {
+template<Endian E>
+void Usd1::read(BinaryReader &stream, const BaseHeader &header) {
     data.resize(sectionSize - 8);
     stream.read(data.data(), data.size());
+    bom = header.bom;
+}
+
+/**
+ * @brief copies usd1 data into the other byte order
+ *
+ * The data is a u16 entry count and padding, then one record per entry: name
+ * and value offsets relative to the record, a u16 value count, a u8 type and
+ * padding. Names and string values are bytes, int32 and float values are swapped.
+ */
+static std::vector<char> swapUserData(const std::vector<char> &data, bool revEndian) {
+    auto swapped = data;
+    // returns the field in host order and swaps it in the copy
+    auto swapField = [&](std::size_t offset, auto zero) {
+        using T = decltype(zero);
+        if (offset + sizeof(T) > swapped.size()) {
+            throw std::runtime_error("usd1 data is truncated");
+        }
+        T raw;
+        std::memcpy(&raw, swapped.data() + offset, sizeof(T));
+        auto value = byteswap(raw);
+        std::memcpy(swapped.data() + offset, &value, sizeof(T));
+        return revEndian ? value : raw;
+    };
+    auto numEntries = swapField(0, std::uint16_t());
+    for (std::size_t i=0; i<numEntries; ++i) {
+        std::size_t entry = 4 + i * 0xc;
+        swapField(entry, std::uint32_t());
+        std::size_t dataOffset = swapField(entry + 4, std::uint32_t());
+        auto numValues = swapField(entry + 8, std::uint16_t());
+        if (entry + 0xc > swapped.size()) {
+            throw std::runtime_error("usd1 data is truncated");
+        }
+        auto type = std::uint8_t(swapped[entry + 10]);
+        if (type > 2) {
+            throw std::runtime_error("usd1 entry has unknown type " + std::to_string(type));
+        }
+        // type 0 is a string
+        for (std::size_t j=0; type != 0 && j<numValues; ++j) {
+            swapField(entry + dataOffset + j * 4, std::uint32_t());
+        }
+    }
+    return swapped;
 }
 
-void Usd1::write(std::ostream &stream, const BaseHeader &header) {
+template<Endian E>
+void Usd1::write(BinaryWriter &stream, const BaseHeader &header) {
     sectionSize = data.size() + 8;
+    if (bom && bom != header.bom) {
+        // the writer's order is the other one, so the data is in reversed order for it
+        auto swapped = swapUserData(data, E == NATIVE_ENDIAN);
+        stream.write(swapped.data(), swapped.size());
+        return;
+    }
     stream.write(data.data(), data.size());
 }
 
-void Pan1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    flags = readNumber<std::uint8_t>(stream, revEndian);
-    auto origin = readNumber<std::uint8_t>(stream, revEndian);
-    alpha = readNumber<std::uint8_t>(stream, revEndian);
-    paneMagFlags = readNumber<std::uint8_t>(stream, revEndian);
-    name = readFixedStr(stream, 0x10);
-    userDataInfo = readFixedStr(stream, 0x8);
-    translate.read(stream, revEndian);
-    rotate.read(stream, revEndian);
-    scale.read(stream, revEndian);
-    width = readNumber<float>(stream, revEndian);
-    height = readNumber<float>(stream, revEndian);
+std::uint32_t Usd1::size(const BaseHeader &) {
+    return data.size();
+}
+
+template<Endian E>
+void Pan1::read(BinaryReader &stream, const BaseHeader &) {
+    flags = readNumber<std::uint8_t, E>(stream);
+    auto origin = readNumber<std::uint8_t, E>(stream);
+    alpha = readNumber<std::uint8_t, E>(stream);
+    paneMagFlags = readNumber<std::uint8_t, E>(stream);
+    name = readFixedName<0x10>(stream);
+    userDataInfo = readFixedName<0x8>(stream);
+    translate.read<E>(stream);
+    rotate.read<E>(stream);
+    scale.read<E>(stream);
+    width = readNumber<float, E>(stream);
+    height = readNumber<float, E>(stream);
     originX = ORIGIN_X_MAP[origin % 3];
     originY = ORIGIN_Y_MAP[origin / 3];
 }
 
-void Pan1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-
+template<Endian E>
+void Pan1::write(BinaryWriter &stream, const BaseHeader &) {
     uint8_t originXIdx = std::find(ORIGIN_X_MAP.begin(), ORIGIN_X_MAP.end(), originX) - ORIGIN_X_MAP.begin();
     uint8_t originYIdx = std::find(ORIGIN_Y_MAP.begin(), ORIGIN_Y_MAP.end(), originY) - ORIGIN_Y_MAP.begin();
     uint8_t origin = originXIdx + 3*originYIdx;
 
-    writeNumber(flags, stream, revEndian);
-    writeNumber(origin, stream, revEndian);
-    writeNumber(alpha, stream, revEndian);
-    writeNumber(paneMagFlags, stream, revEndian);
-    writeFixedStr(name, stream, 0x10);
-    writeFixedStr(userDataInfo, stream, 0x8);
-    translate.write(stream, revEndian);
-    rotate.write(stream, revEndian);
-    scale.write(stream, revEndian);
-    writeNumber(width, stream, revEndian);
-    writeNumber(height, stream, revEndian);
+    writeNumber<E>(flags, stream);
+    writeNumber<E>(origin, stream);
+    writeNumber<E>(alpha, stream);
+    writeNumber<E>(paneMagFlags, stream);
+    writeFixedName(name, stream);
+    writeFixedName(userDataInfo, stream);
+    translate.write<E>(stream);
+    rotate.write<E>(stream);
+    scale.write<E>(stream);
+    writeNumber<E>(width, stream);
+    writeNumber<E>(height, stream);
 }
 
-std::string Pan1::signature() {
-    return Pan1::MAGIC;
+std::uint32_t Pan1::size(const BaseHeader &) {
+    return 0x44;
 }
 
-void Pic1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+std::string_view Pan1::signature() {
+    return Pan1::MAGIC;
+}
 
-    Pan1::read(stream, header);
-    colorTopLeft = readColor8(stream, revEndian);
-    colorTopRight = readColor8(stream, revEndian);
-    colorBottomLeft = readColor8(stream, revEndian);
-    colorBottomRight = readColor8(stream, revEndian);
-    auto materialIndex = readNumber<std::uint16_t>(stream, revEndian);
+template<Endian E>
+void Pic1::read(BinaryReader &stream, const BaseHeader &header) {
+    Pan1::read<E>(stream, header);
+    colorTopLeft = readColor8<E>(stream);
+    colorTopRight = readColor8<E>(stream);
+    colorBottomLeft = readColor8<E>(stream);
+    colorBottomRight = readColor8<E>(stream);
+    auto materialIndex = readNumber<std::uint16_t, E>(stream);
     material = static_cast<const Brlyt &>(header).mat1.materials[materialIndex];
-    auto numUVs = readNumber<std::uint8_t>(stream, revEndian);
+    auto numUVs = readNumber<std::uint8_t, E>(stream);
     stream.seekg(1, std::ios::cur);
     texCoords.resize(numUVs);
-    for (auto &texCoord: texCoords) {
-        texCoord.topLeft.read(stream, revEndian);
-        texCoord.topRight.read(stream, revEndian);
-        texCoord.bottomLeft.read(stream, revEndian);
-        texCoord.bottomRight.read(stream, revEndian);
-    }
-}
-
-void Pic1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-
-    Pan1::write(stream, header);
-    writeColor8(colorTopLeft, stream, revEndian);
-    writeColor8(colorTopRight, stream, revEndian);
-    writeColor8(colorBottomLeft, stream, revEndian);
-    writeColor8(colorBottomRight, stream, revEndian);
-    auto &materials = static_cast<const Brlyt &>(header).mat1.materials;
-    std::uint16_t materialIndex = std::find(materials.begin(), materials.end(), material) - materials.begin();
-    writeNumber(materialIndex, stream, revEndian);
-    writeNumber((std::uint8_t)texCoords.size(), stream, revEndian);
+    readArray<E>(stream, reinterpret_cast<float *>(texCoords.data()), texCoords.size() * 8);
+}
+
+template<Endian E>
+void Pic1::write(BinaryWriter &stream, const BaseHeader &header) {
+    Pan1::write<E>(stream, header);
+    writeColor8<E>(colorTopLeft, stream);
+    writeColor8<E>(colorTopRight, stream);
+    writeColor8<E>(colorBottomLeft, stream);
+    writeColor8<E>(colorBottomRight, stream);
+    std::uint16_t materialIndex = static_cast<const Brlyt &>(header).materialIndex(material);
+    writeNumber<E>(materialIndex, stream);
+    writeNumber<E>((std::uint8_t)texCoords.size(), stream);
     stream.put('\0');
-    for (auto &texCoord: texCoords) {
-        texCoord.topLeft.write(stream, revEndian);
-        texCoord.topRight.write(stream, revEndian);
-        texCoord.bottomLeft.write(stream, revEndian);
-        texCoord.bottomRight.write(stream, revEndian);
-    }
+    writeArray<E>(reinterpret_cast<const float *>(texCoords.data()), texCoords.size() * 8, stream);
 }
 
-std::string Pic1::signature() {
-    return Pic1::MAGIC;
+std::uint32_t Pic1::size(const BaseHeader &header) {
+    return Pan1::size(header) + 0x14 + texCoords.size() * sizeof(TexCoord);
 }
 
-void Txt1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
+std::string_view Pic1::signature() {
+    return Pic1::MAGIC;
+}
 
-    Pan1::read(stream, header);
-    textLen = readNumber<std::uint16_t>(stream, revEndian);
-    maxTextLen = readNumber<std::uint16_t>(stream, revEndian);
-    auto materialIndex = readNumber<std::uint16_t>(stream, revEndian);
+template<Endian E>
+void Txt1::read(BinaryReader &stream, const BaseHeader &header) {
+    Pan1::read<E>(stream, header);
+    textLen = readNumber<std::uint16_t, E>(stream);
+    maxTextLen = readNumber<std::uint16_t, E>(stream);
+    auto materialIndex = readNumber<std::uint16_t, E>(stream);
     material = static_cast<const Brlyt &>(header).mat1.materials[materialIndex];
-    auto fontIndex = readNumber<std::uint16_t>(stream, revEndian);
+    auto fontIndex = readNumber<std::uint16_t, E>(stream);
     font = static_cast<const Brlyt &>(header).fnl1.fonts[fontIndex];
-    textAlign = readNumber<std::uint8_t>(stream, revEndian);
-    lineAlign = (LineAlign)readNumber<std::uint8_t>(stream, revEndian);
-    flagsTxt1 = readNumber<std::uint8_t>(stream, revEndian);
+    textAlign = readNumber<std::uint8_t, E>(stream);
+    lineAlign = (LineAlign)readNumber<std::uint8_t, E>(stream);
+    flagsTxt1 = readNumber<std::uint8_t, E>(stream);
     stream.seekg(1, std::ios::cur);
-    auto textOffset = readNumber<std::uint32_t>(stream, revEndian);
-    fontTopColor = readColor8(stream, revEndian);
-    fontBottomColor = readColor8(stream, revEndian);
-    fontSize.read(stream, revEndian);
-    charSpace = readNumber<float>(stream, revEndian);
-    lineSpace = readNumber<float>(stream, revEndian);
-    text = readNullTerminatedStrU16(stream, revEndian);
-}
-
-void Txt1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-
-    Pan1::write(stream, header);
-    writeNumber(textLen, stream, revEndian);
-    writeNumber(maxTextLen, stream, revEndian);
-    auto &materials = static_cast<const Brlyt &>(header).mat1.materials;
-    std::uint16_t materialIndex = std::find(materials.begin(), materials.end(), material) - materials.begin();
-    writeNumber(materialIndex, stream, revEndian);
-    auto &fonts = static_cast<const Brlyt &>(header).fnl1.fonts;
-    std::uint16_t fontIndex = std::find(fonts.begin(), fonts.end(), font) - fonts.begin();
-    writeNumber(fontIndex, stream, revEndian);
-    writeNumber(textAlign, stream, revEndian);
-    writeNumber((std::uint8_t)lineAlign, stream, revEndian);
-    writeNumber(flagsTxt1, stream, revEndian);
+    auto textOffset = readNumber<std::uint32_t, E>(stream);
+    fontTopColor = readColor8<E>(stream);
+    fontBottomColor = readColor8<E>(stream);
+    fontSize.read<E>(stream);
+    charSpace = readNumber<float, E>(stream);
+    lineSpace = readNumber<float, E>(stream);
+    text = readNullTerminatedStrU16<E>(stream);
+}
+
+template<Endian E>
+void Txt1::write(BinaryWriter &stream, const BaseHeader &header) {
+    Pan1::write<E>(stream, header);
+    writeNumber<E>(textLen, stream);
+    writeNumber<E>(maxTextLen, stream);
+    std::uint16_t materialIndex = static_cast<const Brlyt &>(header).materialIndex(material);
+    writeNumber<E>(materialIndex, stream);
+    std::uint16_t fontIndex = static_cast<const Brlyt &>(header).fontIndex(font);
+    writeNumber<E>(fontIndex, stream);
+    writeNumber<E>(textAlign, stream);
+    writeNumber<E>((std::uint8_t)lineAlign, stream);
+    writeNumber<E>(flagsTxt1, stream);
     stream.put('\0');
-    writeNumber(std::uint32_t(0x74), stream, revEndian);
-    writeColor8(fontTopColor, stream, revEndian);
-    writeColor8(fontBottomColor, stream, revEndian);
-    fontSize.write(stream, revEndian);
-    writeNumber(charSpace, stream, revEndian);
-    writeNumber(lineSpace, stream, revEndian);
-    writeNullTerminatedStrU16(text, stream, revEndian);
+    writeNumber<E>(std::uint32_t(0x74), stream);
+    writeColor8<E>(fontTopColor, stream);
+    writeColor8<E>(fontBottomColor, stream);
+    fontSize.write<E>(stream);
+    writeNumber<E>(charSpace, stream);
+    writeNumber<E>(lineSpace, stream);
+    writeNullTerminatedStrU16<E>(text, stream);
 }
 
-std::string Txt1::signature() {
+std::uint32_t Txt1::size(const BaseHeader &header) {
+    return Pan1::size(header) + 0x28 + (text.size() + 1) * sizeof(char16_t);
+}
+
+std::string_view Txt1::signature() {
     return Txt1::MAGIC;
 }
 
-void Bnd1::read(std::istream &stream, const BaseHeader &header) {
-    Pan1::read(stream, header);
+template<Endian E>
+void Bnd1::read(BinaryReader &stream, const BaseHeader &header) {
+    Pan1::read<E>(stream, header);
 }
 
-void Bnd1::write(std::ostream &stream, const BaseHeader &header) {
-    Pan1::write(stream, header);
+template<Endian E>
+void Bnd1::write(BinaryWriter &stream, const BaseHeader &header) {
+    Pan1::write<E>(stream, header);
 }
 
-std::string Bnd1::signature() {
+std::string_view Bnd1::signature() {
     return Bnd1::MAGIC;
 }
 
-void WindowContent::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    colorTopLeft = readColor8(stream, revEndian);
-    colorTopRight = readColor8(stream, revEndian);
-    colorBottomLeft = readColor8(stream, revEndian);
-    colorBottomRight = readColor8(stream, revEndian);
-    auto materialIndex = readNumber<std::uint16_t>(stream, revEndian);
+template<Endian E>
+void WindowContent::read(BinaryReader &stream, const BaseHeader &header) {
+    colorTopLeft = readColor8<E>(stream);
+    colorTopRight = readColor8<E>(stream);
+    colorBottomLeft = readColor8<E>(stream);
+    colorBottomRight = readColor8<E>(stream);
+    auto materialIndex = readNumber<std::uint16_t, E>(stream);
     material = static_cast<const Brlyt &>(header).mat1.materials[materialIndex];
-    auto uvCount = readNumber<std::uint8_t>(stream, revEndian);
+    auto uvCount = readNumber<std::uint8_t, E>(stream);
     stream.seekg(1, std::ios::cur);
     texCoords.resize(uvCount);
-    for (auto &texCoord: texCoords) {
-        texCoord.topLeft.read(stream, revEndian);
-        texCoord.topRight.read(stream, revEndian);
-        texCoord.bottomLeft.read(stream, revEndian);
-        texCoord.bottomRight.read(stream, revEndian);
-    }
-}
-
-void WindowContent::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    writeColor8(colorTopLeft, stream, revEndian);
-    writeColor8(colorTopRight, stream, revEndian);
-    writeColor8(colorBottomLeft, stream, revEndian);
-    writeColor8(colorBottomRight, stream, revEndian);
-    auto &materials = static_cast<const Brlyt &>(header).mat1.materials;
-    std::uint16_t materialIndex = std::find(materials.begin(), materials.end(), material) - materials.begin();
-    writeNumber(materialIndex, stream, revEndian);
-    writeNumber((std::uint8_t)texCoords.size(), stream, revEndian);
+    readArray<E>(stream, reinterpret_cast<float *>(texCoords.data()), texCoords.size() * 8);
+}
+
+template<Endian E>
+void WindowContent::write(BinaryWriter &stream, const BaseHeader &header) {
+    writeColor8<E>(colorTopLeft, stream);
+    writeColor8<E>(colorTopRight, stream);
+    writeColor8<E>(colorBottomLeft, stream);
+    writeColor8<E>(colorBottomRight, stream);
+    std::uint16_t materialIndex = static_cast<const Brlyt &>(header).materialIndex(material);
+    writeNumber<E>(materialIndex, stream);
+    writeNumber<E>((std::uint8_t)texCoords.size(), stream);
     stream.put('\0');
-    for (auto &texCoord: texCoords) {
-        texCoord.topLeft.write(stream, revEndian);
-        texCoord.topRight.write(stream, revEndian);
-        texCoord.bottomLeft.write(stream, revEndian);
-        texCoord.bottomRight.write(stream, revEndian);
-    } 
+    writeArray<E>(reinterpret_cast<const float *>(texCoords.data()), texCoords.size() * 8, stream);
 }
 
-void WindowFrame::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto materialIndex = readNumber<std::uint16_t>(stream, revEndian);
+std::uint32_t WindowContent::size() const {
+    return 0x14 + texCoords.size() * sizeof(TexCoord);
+}
+
+template<Endian E>
+void WindowFrame::read(BinaryReader &stream, const BaseHeader &header) {
+    auto materialIndex = readNumber<std::uint16_t, E>(stream);
     material = static_cast<const Brlyt &>(header).mat1.materials[materialIndex];
-    texFlip = (WindowFrameTexFlip)readNumber<std::uint8_t>(stream, revEndian);
+    texFlip = (WindowFrameTexFlip)readNumber<std::uint8_t, E>(stream);
     stream.seekg(1, std::ios::cur);
 }
 
-void WindowFrame::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto &materials = static_cast<const Brlyt &>(header).mat1.materials;
-    std::uint16_t materialIndex = std::find(materials.begin(), materials.end(), material) - materials.begin();
-    writeNumber(materialIndex, stream, revEndian);
-    writeNumber((std::uint8_t)texFlip, stream, revEndian);
+template<Endian E>
+void WindowFrame::write(BinaryWriter &stream, const BaseHeader &header) {
+    std::uint16_t materialIndex = static_cast<const Brlyt &>(header).materialIndex(material);
+    writeNumber<E>(materialIndex, stream);
+    writeNumber<E>((std::uint8_t)texFlip, stream);
     stream.put('\0');
 }
 
-void Wnd1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-
-    Pan1::read(stream, header);
+template<Endian E>
+void Wnd1::read(BinaryReader &stream, const BaseHeader &header) {
+    Pan1::read<E>(stream, header);
     auto pos = stream.tellg() - std::streamoff(0x4c);
-    stretchLeft = readNumber<std::uint16_t>(stream, revEndian);
-    stretchRight = readNumber<std::uint16_t>(stream, revEndian);
-    stretchTop = readNumber<std::uint16_t>(stream, revEndian);
-    stretchBottom = readNumber<std::uint16_t>(stream, revEndian);
-    frameElementLeft = readNumber<std::uint16_t>(stream, revEndian);
-    frameElementRight = readNumber<std::uint16_t>(stream, revEndian);
-    frameElementTop = readNumber<std::uint16_t>(stream, revEndian);
-    frameElementBottom = readNumber<std::uint16_t>(stream, revEndian);
-    auto frameCount = readNumber<std::uint8_t>(stream, revEndian);
-    flagsWnd1 = readNumber<std::uint8_t>(stream, revEndian);
+    stretchLeft = readNumber<std::uint16_t, E>(stream);
+    stretchRight = readNumber<std::uint16_t, E>(stream);
+    stretchTop = readNumber<std::uint16_t, E>(stream);
+    stretchBottom = readNumber<std::uint16_t, E>(stream);
+    frameElementLeft = readNumber<std::uint16_t, E>(stream);
+    frameElementRight = readNumber<std::uint16_t, E>(stream);
+    frameElementTop = readNumber<std::uint16_t, E>(stream);
+    frameElementBottom = readNumber<std::uint16_t, E>(stream);
+    auto frameCount = readNumber<std::uint8_t, E>(stream);
+    flagsWnd1 = readNumber<std::uint8_t, E>(stream);
     stream.seekg(2, std::ios::cur);
-    auto contentOffset = readNumber<std::uint32_t>(stream, revEndian);
-    auto frameOffsetTbl = readNumber<std::uint32_t>(stream, revEndian);
+    auto contentOffset = readNumber<std::uint32_t, E>(stream);
+    auto frameOffsetTbl = readNumber<std::uint32_t, E>(stream);
     stream.seekg(pos + std::streamoff(contentOffset));
-    content.read(stream, header);
+    content.read<E>(stream, header);
     stream.seekg(pos + std::streamoff(frameOffsetTbl));
     frames.resize(frameCount);
     for (auto &frame: frames) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
+        auto off = readNumber<std::uint32_t, E>(stream);
         {
             TemporarySeekI ts(stream, pos + std::streamoff(off));
-            frame.read(stream, header);
+            frame.read<E>(stream, header);
         }
     }
 }
 
-void Wnd1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-
-    Pan1::write(stream, header);
-    auto pos = stream.tellp() - std::streamoff(0x4c);
-    writeNumber(stretchLeft, stream, revEndian);
-    writeNumber(stretchRight, stream, revEndian);
-    writeNumber(stretchTop, stream, revEndian);
-    writeNumber(stretchBottom, stream, revEndian);
-    writeNumber(frameElementLeft, stream, revEndian);
-    writeNumber(frameElementRight, stream, revEndian);
-    writeNumber(frameElementTop, stream, revEndian);
-    writeNumber(frameElementBottom, stream, revEndian);
-    writeNumber((std::uint8_t)frames.size(), stream, revEndian);
-    writeNumber(flagsWnd1, stream, revEndian);
+template<Endian E>
+void Wnd1::write(BinaryWriter &stream, const BaseHeader &header) {
+    Pan1::write<E>(stream, header);
+    writeNumber<E>(stretchLeft, stream);
+    writeNumber<E>(stretchRight, stream);
+    writeNumber<E>(stretchTop, stream);
+    writeNumber<E>(stretchBottom, stream);
+    writeNumber<E>(frameElementLeft, stream);
+    writeNumber<E>(frameElementRight, stream);
+    writeNumber<E>(frameElementTop, stream);
+    writeNumber<E>(frameElementBottom, stream);
+    writeNumber<E>((std::uint8_t)frames.size(), stream);
+    writeNumber<E>(flagsWnd1, stream);
     stream.put('\0');
     stream.put('\0');
     
-    auto offsetStartPos = stream.tellp();
-    stream.write("\0\0\0\0\0\0\0\0", 8);
-    auto pos2 = stream.tellp();
-    stream.seekp(offsetStartPos);
-    writeNumber(std::uint32_t(pos2 - pos), stream, revEndian);
-    {
-        TemporarySeekO ts(stream, pos2);
-        content.write(stream, header);
-        pos2 = stream.tellp();
-    }
-    writeNumber(std::uint32_t(pos2 - pos), stream, revEndian);
-    stream.seekp(pos2);
-    auto frameOffStartPos = stream.tellp();
+    // offsets are relative to the start of the section header
+    std::uint32_t contentOffset = 8 + Pan1::size(header) + 0x1c;
+    std::uint32_t frameOffsetTbl = contentOffset + content.size();
+    writeNumber<E>(contentOffset, stream);
+    writeNumber<E>(frameOffsetTbl, stream);
+    content.write<E>(stream, header);
+    std::uint32_t frameOffset = frameOffsetTbl + frames.size() * sizeof(std::uint32_t);
     for (int i=0; i<frames.size(); ++i) {
-        writeNumber(std::uint32_t(0), stream, revEndian);
+        writeNumber<E>(frameOffset, stream);
+        frameOffset += 4;
     }
-    auto pos3 = stream.tellp();
-    stream.seekp(frameOffStartPos);
     for (auto &frame: frames) {
-        writeNumber(std::uint32_t(pos3 - pos), stream, revEndian);
-        {
-            TemporarySeekO ts1(stream, pos3);
-            frame.write(stream, header);
-            pos3 = stream.tellp();
-        }
+        frame.write<E>(stream, header);
     }
-    stream.seekp(pos3); // seek to end of allocated stuff
 }
 
-std::string Wnd1::signature() {
-    return Wnd1::MAGIC;
-}
-
-void Grp1::read(std::istream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    name = readFixedStr(stream, 0x10);
-    auto numNodes = readNumber<std::uint16_t>(stream, revEndian);
-    stream.seekg(2, std::ios::cur);
-    for (int i=0; i<numNodes; ++i) {
-        panes.push_back(readFixedStr(stream, 0x10));
-    }
+std::uint32_t Wnd1::size(const BaseHeader &header) {
+    return Pan1::size(header) + 0x1c + content.size() + frames.size() * 2 * sizeof(std::uint32_t);
 }
 
-void Grp1::write(std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    writeFixedStr(name, stream, 0x10);
-    writeNumber((std::uint16_t)panes.size(), stream, revEndian);
-    stream.put('\0');
-    stream.put('\0');
-    for (auto &node: panes) {
-        writeFixedStr(node, stream, 0x10);
-    }
+std::string_view Wnd1::signature() {
+    return Wnd1::MAGIC;
 }
 
 template<class T>
@@ -701,170 +822,609 @@ static void setPane(std::shared_ptr<T> pane, std::shared_ptr<T> parentPane) {
 }
 
 void Brlyt::read(std::istream &stream) {
-    auto magic = readFixedStr(stream, 4);
-    bool reverseEndian;
-    if (magic != MAGIC) {
-        // TODO throw exception here
-    }
-    bom = readNumber<std::uint16_t>(stream, false);
-    reverseEndian = revEndian();
-    version = readNumber<std::uint16_t>(stream, reverseEndian);
-    auto fileSize = readNumber<std::uint32_t>(stream, reverseEndian);
-    headerSize = readNumber<std::uint16_t>(stream, reverseEndian);
-    auto sectionCount = readNumber<std::uint16_t>(stream, reverseEndian);
+    auto buffer = readAll(stream);
+    read(buffer.data(), buffer.size());
+}
+
+void Brlyt::read(const char *data, std::size_t size) {
+    BinaryReader reader(data, size);
+    read(reader);
+}
+
+/**
+ * @brief user data slot of a pane, found by dispatching on its kind; groups have none
+ */
+static std::optional<Usd1> *userDataOf(BasePane &pane) {
+    return visitPane(pane, [](Pan1 &pan1) { return &pan1.userData; });
+}
+
+static std::optional<Usd1> *userDataOf(GroupPane &) {
+    return nullptr;
+}
+
+/**
+ * @brief reads a pane in byte order E, dispatching on its kind instead of a virtual call
+ */
+template<Endian E>
+static void readPaneContent(BasePane &pane, BinaryReader &stream, const BaseHeader &header) {
+    visitPane(pane, [&](auto &concrete) {
+        concrete.template read<E>(stream, header);
+    });
+}
+
+void Brlyt::read(BinaryReader &stream) {
+    auto sectionCount = readFileHeader(stream, MAGIC);
 
     stream.seekg(headerSize);
 
+    if (!arena) {
+        // node memory scales with the file, so size the first chunk after it
+        arena = std::make_shared<Arena>(stream.size());
+    }
+
     std::shared_ptr<BasePane> curPane, parentPane;
     std::shared_ptr<GroupPane> curGroupPane, parentGroupPane;
+    paneTable.clear();
+
+    // the byte order is checked once here, so every section below reads without branching on it
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        for (int i=0; i<sectionCount; ++i) {
+            auto pos = stream.tellg();
+
+            auto sectionMagic = readNumber<std::uint32_t, Endian::Big>(stream);
+            auto sectionSize = readNumber<std::uint32_t, E>(stream);
+            SectionTimer timer(observer, sectionMagic, false, sectionSize);
+
+            bool addPane = false;
+
+            switch (sectionMagic) {
+            case Lyt1::FOURCC:
+                lyt1.read<E>(stream, *this);
+                break;
+            case Txl1<true>::FOURCC:
+                txl1.read<E>(stream, *this);
+                break;
+            case Fnl1<true>::FOURCC:
+                fnl1.read<E>(stream, *this);
+                break;
+            case Mat1::FOURCC:
+                mat1.read<E>(stream, *this);
+                break;
+            case Pan1::FOURCC:
+                curPane = makeShared<Pan1>(arena);
+                addPane = true;
+                break;
+            case Pic1::FOURCC:
+                curPane = makeShared<Pic1>(arena);
+                addPane = true;
+                break;
+            case Txt1::FOURCC:
+                curPane = makeShared<Txt1>(arena);
+                addPane = true;
+                break;
+            case Bnd1::FOURCC:
+                curPane = makeShared<Bnd1>(arena);
+                addPane = true;
+                break;
+            case Wnd1::FOURCC:
+                curPane = makeShared<Wnd1>(arena);
+                addPane = true;
+                break;
+            case fourcc(PANE_START_MAGIC):
+                if (curPane) {
+                    parentPane = curPane;
+                }
+                break;
+            case fourcc(PANE_END_MAGIC):
+                curPane = parentPane;
+                parentPane = curPane->parent.lock();
+                break;
+            case Grp1::FOURCC:
+                curGroupPane = makeShared<Grp1>(arena);
+                curGroupPane->read<E>(stream, *this);
+                setPane(curGroupPane, parentGroupPane);
+                break;
+            case fourcc(GROUP_START_MAGIC):
+                if (curGroupPane) {
+                    parentGroupPane = curGroupPane;
+                }
+                break;
+            case fourcc(GROUP_END_MAGIC):
+                curGroupPane = parentGroupPane;
+                parentGroupPane = curGroupPane->parent.lock();
+                break;
+            case Usd1::FOURCC:
+                if (curPane) {
+                    auto &usd1 = userDataOf(*curPane)->emplace();
+                    usd1.sectionSize = sectionSize;
+                    usd1.read<E>(stream, *this);
+                }
+                break;
+            }
 
-    for (int i=0; i<sectionCount; ++i) {
-        auto pos = stream.tellg();
-
-        auto sectionHeader = readFixedStr(stream, 4);
-        auto sectionSize = readNumber<std::uint32_t>(stream, reverseEndian);
-
-        bool addPane = false;
-        
-        if (sectionHeader == Lyt1::MAGIC) {
-            lyt1.read(stream, *this);
-        } else if (sectionHeader == Txl1<true>::MAGIC) {
-            txl1.read(stream, *this);
-        } else if (sectionHeader == Fnl1<true>::MAGIC) {
-            fnl1.read(stream, *this);
-        } else if (sectionHeader == Mat1::MAGIC) {
-            mat1.read(stream, *this);
-        } else if (sectionHeader == Pan1::MAGIC) {
-            curPane = std::make_shared<Pan1>();
-            addPane = true;
-        } else if (sectionHeader == Pic1::MAGIC) {
-            curPane = std::make_shared<Pic1>();
-            addPane = true;
-        } else if (sectionHeader == Txt1::MAGIC) {
-            curPane = std::make_shared<Txt1>();
-            addPane = true;
-        } else if (sectionHeader == Bnd1::MAGIC) {
-            curPane = std::make_shared<Bnd1>();
-            addPane = true;
-        } else if (sectionHeader == Wnd1::MAGIC) {
-            curPane = std::make_shared<Wnd1>();
-            addPane = true;
-        } else if (sectionHeader == "pas1") {
-            if (curPane) {
-                parentPane = curPane;
+            if (addPane) {
+                readPaneContent<E>(*curPane, stream, *this);
+                setPane(curPane, parentPane);
+                paneTable.emplace(curPane->name, curPane);
             }
-        } else if (sectionHeader == "pae1") {
-            curPane = parentPane;
-            parentPane = curPane->parent.lock();
-        } else if (sectionHeader == Grp1::MAGIC) {
-            curGroupPane = std::make_shared<Grp1>();
-            curGroupPane->read(stream, *this);
-            setPane(curGroupPane, parentGroupPane);
-        } else if (sectionHeader == "grs1") {
-            if (curGroupPane) {
-                parentGroupPane = curGroupPane;
+
+            if (!rootPane && sectionMagic == Pan1::FOURCC) {
+                rootPane = curPane;
             }
-        } else if (sectionHeader == "gre1") {
-            curGroupPane = parentGroupPane;
-            parentGroupPane = curGroupPane->parent.lock();
-        } else if (sectionHeader == "usd1") {
-            auto associatedPane = std::dynamic_pointer_cast<Pan1>(curPane);
-            if (associatedPane) {
-                auto &usd1 = associatedPane->userData.emplace();
-                usd1.sectionSize = sectionSize;
-                usd1.read(stream, *this);
+
+            if (!rootGroup && sectionMagic == Grp1::FOURCC) {
+                rootGroup = curGroupPane;
             }
+
+            stream.seekg(pos + std::streamoff(sectionSize));
         }
+    });
+}
+
+static void indexPanes(decltype(Brlyt::paneTable) &table, const std::shared_ptr<BasePane> &pane) {
+    table.emplace(pane->name, pane);
+    for (auto &child: pane->children) {
+        indexPanes(table, child);
+    }
+}
+
+static void unindexPanes(decltype(Brlyt::paneTable) &table, const std::shared_ptr<BasePane> &pane) {
+    auto it = table.find(pane->name);
+    if (it != table.end() && it->second == pane) {
+        table.erase(it);
+    }
+    for (auto &child: pane->children) {
+        unindexPanes(table, child);
+    }
+}
+
+std::shared_ptr<BasePane> Brlyt::findPane(const FixedName<0x10> &name) const {
+    auto it = paneTable.find(name);
+    return it == paneTable.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<BasePane> Brlyt::findPane(std::string_view name) const {
+    // a longer name cannot be a pane name
+    if (name.size() > FixedName<0x10>::CAPACITY) {
+        return nullptr;
+    }
+    return findPane(FixedName<0x10>(name));
+}
 
-        if (addPane) {
-            curPane->read(stream, *this);
-            setPane(curPane, parentPane);
+std::vector<std::shared_ptr<BasePane>> Brlyt::findPanes(const GroupPane &group) const {
+    std::vector<std::shared_ptr<BasePane>> result;
+    result.reserve(group.panes.size());
+    for (auto &name: group.panes) {
+        auto pane = findPane(name);
+        if (pane) {
+            result.push_back(std::move(pane));
         }
+    }
+    return result;
+}
 
-        if (!rootPane && sectionHeader == Pan1::MAGIC) {
-            rootPane = curPane;
+void Brlyt::addPane(const std::shared_ptr<BasePane> &pane, const std::shared_ptr<BasePane> &parent) {
+    for (auto ancestor = parent; ancestor; ancestor = ancestor->parent.lock()) {
+        if (ancestor == pane) {
+            throw std::invalid_argument("pane " + pane->name.str() + " cannot be added below itself");
         }
+    }
+    // a pane has one parent, so moving it takes it out of its old place first
+    if (!pane->parent.expired() || pane == rootPane) {
+        removePane(pane);
+    }
+    if (!parent) {
+        rootPane = pane;
+        pane->parent.reset();
+        rebuildPaneTable();
+        return;
+    }
+    parent->children.push_back(pane);
+    pane->parent = parent;
+    indexPanes(paneTable, pane);
+}
 
-        if (!rootGroup && sectionHeader == Grp1::MAGIC) {
-            rootGroup = curGroupPane;
+void Brlyt::removePane(const std::shared_ptr<BasePane> &pane) {
+    unindexPanes(paneTable, pane);
+    auto parent = pane->parent.lock();
+    if (parent) {
+        auto &siblings = parent->children;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), pane), siblings.end());
+        pane->parent.reset();
+    } else if (pane == rootPane) {
+        rootPane = nullptr;
+    }
+}
+
+void Brlyt::renamePane(const std::shared_ptr<BasePane> &pane, std::string_view name) {
+    FixedName<0x10> newName(name);
+    auto taken = paneTable.find(newName);
+    if (taken != paneTable.end() && taken->second != pane) {
+        throw std::invalid_argument("pane name " + newName.str() + " is already taken");
+    }
+    auto it = paneTable.find(pane->name);
+    bool indexed = it != paneTable.end() && it->second == pane;
+    if (indexed) {
+        paneTable.erase(it);
+    }
+    pane->name = newName;
+    if (indexed) {
+        paneTable.emplace(pane->name, pane);
+    }
+}
+
+void Brlyt::rebuildPaneTable() {
+    paneTable.clear();
+    if (rootPane) {
+        indexPanes(paneTable, rootPane);
+    }
+}
+
+template<class T, class Key, class Map>
+static std::uint16_t lookupIndex(const std::vector<T> &list, const Key &key, const Map &map) {
+    auto it = map.find(key);
+    return it == map.end() ? list.size() : it->second;
+}
+
+std::uint16_t Brlyt::materialIndex(const std::shared_ptr<Material> &material) const {
+    if (!writeIndexBuilt) {
+        auto &materials = mat1.materials;
+        return std::find(materials.begin(), materials.end(), material) - materials.begin();
+    }
+    return lookupIndex(mat1.materials, material.get(), writeIndex.materials);
+}
+
+std::uint16_t Brlyt::textureIndex(const std::string &name) const {
+    if (!writeIndexBuilt) {
+        auto &textures = txl1.textures;
+        return std::find(textures.begin(), textures.end(), name) - textures.begin();
+    }
+    return lookupIndex(txl1.textures, std::string_view(name), writeIndex.textures);
+}
+
+std::uint16_t Brlyt::fontIndex(const std::string &name) const {
+    if (!writeIndexBuilt) {
+        auto &fonts = fnl1.fonts;
+        return std::find(fonts.begin(), fonts.end(), name) - fonts.begin();
+    }
+    return lookupIndex(fnl1.fonts, std::string_view(name), writeIndex.fonts);
+}
+
+void Brlyt::buildWriteIndex() {
+    clearWriteIndex();
+    // emplace keeps the first occurrence, like the linear search
+    writeIndex.materials.reserve(mat1.materials.size());
+    for (std::size_t i=0; i<mat1.materials.size(); ++i) {
+        writeIndex.materials.emplace(mat1.materials[i].get(), i);
+    }
+    writeIndex.textures.reserve(txl1.textures.size());
+    for (std::size_t i=0; i<txl1.textures.size(); ++i) {
+        writeIndex.textures.emplace(txl1.textures[i], i);
+    }
+    writeIndex.fonts.reserve(fnl1.fonts.size());
+    for (std::size_t i=0; i<fnl1.fonts.size(); ++i) {
+        writeIndex.fonts.emplace(fnl1.fonts[i], i);
+    }
+    writeIndexBuilt = true;
+}
+
+void Brlyt::clearWriteIndex() {
+    writeIndex.materials.clear();
+    writeIndex.textures.clear();
+    writeIndex.fonts.clear();
+    writeIndexBuilt = false;
+}
+
+template<class F>
+static void forEachMaterialRef(BasePane &pane, F &&f) {
+    switch (pane.kind) {
+    case PaneKind::Picture:
+        f(static_cast<Pic1 &>(pane).material);
+        break;
+    case PaneKind::Text:
+        f(static_cast<Txt1 &>(pane).material);
+        break;
+    case PaneKind::Window: {
+        auto &wnd1 = static_cast<Wnd1 &>(pane);
+        f(wnd1.content.material);
+        for (auto &frame: wnd1.frames) {
+            f(frame.material);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    for (auto &child: pane.children) {
+        forEachMaterialRef(*child, f);
+    }
+}
+
+std::uint32_t Brlyt::dedupMaterials(bool ignoreNames) {
+    auto &materials = mat1.materials;
+    if (materials.size() < 2) {
+        return 0;
+    }
+    auto oldSize = sectionSize(mat1, *this);
+    std::vector<MaterialPtr> kept;
+    std::vector<std::vector<char>> keptBytes;
+    // content hash -> indices into kept; bytes are only compared when hashes match
+    std::unordered_map<std::size_t, std::vector<std::size_t>> buckets;
+    std::unordered_map<const Material *, MaterialPtr> replacements;
+    auto content = [&](const std::vector<char> &bytes) {
+        std::string_view view(bytes.data(), bytes.size());
+        if (ignoreNames) {
+            view.remove_prefix(0x14);
         }
+        return view;
+    };
+    {
+        // materials refer to textures by index, so encode them the way write would
+        WriteIndexScope writeIndexScope(*this);
+        withEndian(revEndian(), [&](auto endian) {
+            for (auto &material: materials) {
+                BinaryWriter writer;
+                material.get()->write<decltype(endian)::value>(writer, *this);
+                auto bytes = writer.release();
+                auto &bucket = buckets[std::hash<std::string_view>()(content(bytes))];
+                auto match = std::find_if(bucket.begin(), bucket.end(), [&](std::size_t i) {
+                    return content(keptBytes[i]) == content(bytes);
+                });
+                if (match != bucket.end()) {
+                    replacements.emplace(material.get(), kept[*match]);
+                } else {
+                    bucket.push_back(kept.size());
+                    kept.push_back(material);
+                    keptBytes.push_back(std::move(bytes));
+                }
+            }
+        });
+    }
+    if (replacements.empty()) {
+        return 0;
+    }
+
+    if (rootPane) {
+        forEachMaterialRef(*rootPane, [&](MaterialPtr &material) {
+            auto it = replacements.find(material.get());
+            if (it != replacements.end()) {
+                material = it->second;
+            }
+        });
+    }
+    materials = std::move(kept);
+    return oldSize - sectionSize(mat1, *this);
+}
 
-        stream.seekg(pos + std::streamoff(sectionSize));
+void Brlyt::decodeMaterials() {
+    for (auto &material: mat1.materials) {
+        material.get()->decode();
     }
 }
 
-template<class Pane, class SecCount>
-static void writePanes(Pane &pane, std::ostream &stream, const BaseHeader &header, const std::string &startTag, const std::string &endTag, SecCount &secCount) {
-    writeSection(pane.signature(), pane, stream, header);
-    ++secCount;
-    auto pan1 = dynamic_cast<Pan1 *>(&pane);
-    if (pan1) {
-        if (pan1->userData.has_value()) {
-            writeSection(Usd1::MAGIC, pan1->userData.value(), stream, header);
-            ++secCount;
+std::vector<SectionEntry> Brlyt::scan(BinaryReader &stream) {
+    return scanSections(stream, MAGIC);
+}
+
+void Brlyt::readSection(BinaryReader &stream, const SectionEntry &entry) {
+    if (!arena) {
+        arena = std::make_shared<Arena>(entry.size);
+    }
+    stream.seekg(entry.offset + 8);
+    SectionTimer timer(observer, entry.magic, false, entry.size);
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        switch (entry.magic) {
+        case Lyt1::FOURCC:
+            lyt1.read<E>(stream, *this);
+            break;
+        case Txl1<true>::FOURCC:
+            txl1.read<E>(stream, *this);
+            break;
+        case Fnl1<true>::FOURCC:
+            fnl1.read<E>(stream, *this);
+            break;
+        case Mat1::FOURCC:
+            mat1.materials.clear();
+            mat1.read<E>(stream, *this);
+            break;
+        }
+    });
+}
+
+std::shared_ptr<BasePane> Brlyt::readPane(BinaryReader &stream, const std::vector<SectionEntry> &directory, std::size_t index) {
+    auto &entry = directory.at(index);
+    std::shared_ptr<BasePane> pane;
+    switch (entry.magic) {
+    case Pan1::FOURCC:
+        pane = makeShared<Pan1>(arena);
+        break;
+    case Pic1::FOURCC:
+        pane = makeShared<Pic1>(arena);
+        break;
+    case Txt1::FOURCC:
+        pane = makeShared<Txt1>(arena);
+        break;
+    case Bnd1::FOURCC:
+        pane = makeShared<Bnd1>(arena);
+        break;
+    case Wnd1::FOURCC:
+        pane = makeShared<Wnd1>(arena);
+        break;
+    default:
+        throw std::invalid_argument("section is not a pane");
+    }
+    // panes refer to these by index; an empty list is never written, so empty means unread
+    auto readDependency = [&](std::uint32_t magic, bool unread) {
+        auto dependency = findSection(directory, magic);
+        if (unread && dependency) {
+            readSection(stream, *dependency);
+        }
+    };
+    readDependency(Txl1<true>::FOURCC, txl1.textures.empty());
+    readDependency(Fnl1<true>::FOURCC, fnl1.fonts.empty());
+    readDependency(Mat1::FOURCC, mat1.materials.empty());
+
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        {
+            SectionTimer timer(observer, entry.magic, false, entry.size);
+            stream.seekg(entry.offset + 8);
+            readPaneContent<E>(*pane, stream, *this);
+        }
+        if (index + 1 < directory.size() && directory[index + 1].magic == Usd1::FOURCC) {
+            auto &usdEntry = directory[index + 1];
+            SectionTimer timer(observer, usdEntry.magic, false, usdEntry.size);
+            auto &usd1 = userDataOf(*pane)->emplace();
+            usd1.sectionSize = usdEntry.size;
+            stream.seekg(usdEntry.offset + 8);
+            usd1.read<E>(stream, *this);
         }
+    });
+    return pane;
+}
+
+void Brlyt::loadFile(const std::string &path) {
+    MappedFile file(path);
+    read(file.data(), file.size());
+}
+
+template<class Pane>
+static void measurePanes(Pane &pane, const BaseHeader &header, std::uint32_t &fileSize, std::uint16_t &secCount) {
+    fileSize += sectionSize(pane, header);
+    ++secCount;
+    auto userData = userDataOf(pane);
+    if (userData && userData->has_value()) {
+        fileSize += sectionSize(userData->value(), header);
+        ++secCount;
     }
 
     if (!pane.children.empty()) {
+        fileSize += 2 * 8;
         secCount += 2;
+        for (auto &child: pane.children) {
+            measurePanes(*child, header, fileSize, secCount);
+        }
+    }
+}
+
+/**
+ * @brief writes the section of a pane in byte order E, dispatching on its kind
+ */
+template<Endian E>
+static void writeNode(BasePane &pane, BinaryWriter &stream, const BaseHeader &header) {
+    visitPane(pane, [&](auto &concrete) {
+        writeSection<E>(concrete.MAGIC, concrete, stream, header);
+    });
+}
+
+template<Endian E>
+static void writeNode(GroupPane &group, BinaryWriter &stream, const BaseHeader &header) {
+    writeSection<E>(GroupPane::MAGIC, group, stream, header);
+}
+
+template<Endian E, class Pane>
+static void writePanes(Pane &pane, BinaryWriter &stream, const BaseHeader &header, std::string_view startTag, std::string_view endTag) {
+    writeNode<E>(pane, stream, header);
+    auto userData = userDataOf(pane);
+    if (userData && userData->has_value()) {
+        writeSection<E>(Usd1::MAGIC, userData->value(), stream, header);
+    }
+
+    if (!pane.children.empty()) {
         Section nullSec;
-        writeSection(startTag, nullSec, stream, header);
+        writeSection<E>(startTag, nullSec, stream, header);
         for (auto &child: pane.children) {
-            writePanes(*child, stream, header, startTag, endTag, secCount);
+            writePanes<E>(*child, stream, header, startTag, endTag);
         }
-        writeSection(endTag, nullSec, stream, header);
+        writeSection<E>(endTag, nullSec, stream, header);
     }
 }
 
 void Brlyt::write(std::ostream &stream) {
-    writeFixedStr(MAGIC, stream, 4);
-    bool reverseEndian = revEndian();
-    writeNumber(bom, stream, false);
-    writeNumber((std::uint16_t)version, stream, reverseEndian);
-    auto fileSizePos = stream.tellp();
-    writeNumber(std::uint32_t(0), stream, reverseEndian);
-    // header size
-    writeNumber(std::uint16_t(stream.tellp() + std::streamoff(4)), stream, reverseEndian);
-    auto sectionCountPos = stream.tellp();
-    stream.put('\0');
-    stream.put('\0');
+    auto buffer = serialize();
+    stream.write(buffer.data(), buffer.size());
+}
 
-    uint16_t sectionCount = 1;
+std::vector<char> Brlyt::serialize() {
+    BinaryWriter writer;
+    write(writer);
+    return writer.release();
+}
 
-    writeSection(Lyt1::MAGIC, lyt1, stream, *this);
+void Brlyt::write(BinaryWriter &stream) {
+    // size everything up front so that the file is written strictly forward
+    std::uint32_t fileSize = 0x10;
+    std::uint16_t sectionCount = 1;
+    fileSize += sectionSize(lyt1, *this);
     if (!txl1.textures.empty()) {
-        writeSection(Txl1<true>::MAGIC, txl1, stream, *this);
+        fileSize += sectionSize(txl1, *this);
         ++sectionCount;
     }
     if (!fnl1.fonts.empty()) {
-        writeSection(Fnl1<true>::MAGIC, fnl1, stream, *this);
+        fileSize += sectionSize(fnl1, *this);
         ++sectionCount;
     }
     if (!mat1.materials.empty()) {
-        writeSection(Mat1::MAGIC, mat1, stream, *this);
+        fileSize += sectionSize(mat1, *this);
         ++sectionCount;
     }
-
     if (rootPane) {
-        writePanes(*rootPane, stream, *this, "pas1", "pae1", sectionCount);
+        measurePanes(*rootPane, *this, fileSize, sectionCount);
     }
     if (rootGroup) {
-        writePanes(*rootGroup, stream, *this, "grs1", "gre1", sectionCount);
+        measurePanes(*rootGroup, *this, fileSize, sectionCount);
     }
 
-    {
-        TemporarySeekO ts(stream, sectionCountPos);
-        writeNumber(sectionCount, stream, reverseEndian);
-    }
+    // pane writers resolve materials, textures and fonts through these maps
+    WriteIndexScope writeIndexScope(*this);
 
-    alignFile(stream);
-
-    auto fileEnd = stream.tellp();
+    stream.reserve(stream.size() + fileSize);
+    writeFixedStr(MAGIC, stream, 4);
+    writeNumber(bom, stream, false);
+    withEndian(revEndian(), [&](auto endian) {
+        constexpr Endian E = decltype(endian)::value;
+        writeNumber<E>((std::uint16_t)version, stream);
+        writeNumber<E>(fileSize, stream);
+        // header size
+        writeNumber<E>(std::uint16_t(0x10), stream);
+        writeNumber<E>(sectionCount, stream);
+
+        writeSection<E>(Lyt1::MAGIC, lyt1, stream, *this);
+        if (!txl1.textures.empty()) {
+            writeSection<E>(Txl1<true>::MAGIC, txl1, stream, *this);
+        }
+        if (!fnl1.fonts.empty()) {
+            writeSection<E>(Fnl1<true>::MAGIC, fnl1, stream, *this);
+        }
+        if (!mat1.materials.empty()) {
+            writeSection<E>(Mat1::MAGIC, mat1, stream, *this);
+        }
 
-    {
-        TemporarySeekO ts(stream, fileSizePos);
-        writeNumber((std::uint32_t)fileEnd, stream, reverseEndian);
-    }
+        if (rootPane) {
+            writePanes<E>(*rootPane, stream, *this, PANE_START_MAGIC, PANE_END_MAGIC);
+        }
+        if (rootGroup) {
+            writePanes<E>(*rootGroup, stream, *this, GROUP_START_MAGIC, GROUP_END_MAGIC);
+        }
+    });
 }
 
-}
\ No newline at end of file
+// the members code outside this file reads and writes single records with
+template void Material::read<Endian::Big>(BinaryReader &stream, const BaseHeader &header);
+template void Material::read<Endian::Little>(BinaryReader &stream, const BaseHeader &header);
+template void Material::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Material::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+template void Pan1::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Pan1::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+template void Pic1::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Pic1::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+template void Txt1::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Txt1::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+template void Bnd1::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Bnd1::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+template void Wnd1::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Wnd1::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+
+}
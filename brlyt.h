@@ -9,9 +9,13 @@
 namespace bq::brlyt {
 
 struct Lyt1 : LayoutInfo {
-    static inline const std::string MAGIC = "lyt1";
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    static constexpr std::string_view MAGIC = "lyt1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 enum class TexCoordGenTypes {
@@ -102,8 +106,10 @@ struct TexCoordGenEntry {
     TexCoordGenSource source;
     TexCoordGenMatrixSource matrixSource;
     std::uint8_t unknown;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 struct ChanCtrl {
@@ -111,8 +117,10 @@ struct ChanCtrl {
     std::uint8_t alphaMatSource;
     std::uint8_t unknown1;
     std::uint8_t unknown2;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 enum SwapChannel {
@@ -127,14 +135,18 @@ struct SwapMode {
     SwapChannel g;
     SwapChannel b;
     SwapChannel a;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 struct TevSwapModeTable {
     std::array<SwapMode, 4> swapModes;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 struct IndirectStage {
@@ -142,13 +154,17 @@ struct IndirectStage {
     std::uint8_t texMap;
     std::uint8_t scaleS;
     std::uint8_t scaleT;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 struct TextureRef : BaseTextureRef {
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
 };
 
 struct TevStage : BaseTevStage {
@@ -157,8 +173,10 @@ struct TevStage : BaseTevStage {
     // TODO add bit fields for the flags
     std::uint16_t flag1;
     std::array<std::uint8_t, 12> flags;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 struct AlphaCompare : BaseAlphaCompare {
@@ -167,40 +185,107 @@ struct AlphaCompare : BaseAlphaCompare {
     AlphaOp op;
     std::uint8_t ref0;
     std::uint8_t ref1;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
 };
 
 struct Material : BaseMaterial<TextureRef, TevStage, AlphaCompare> {
     color8 colorRegister3;
     color8 matColor;
     std::array<color8, 4> tevColors;
-    std::vector<TexCoordGenEntry> texCoordGens;
+    SmallVector<TexCoordGenEntry, MAX_TEX_COORD_GENS> texCoordGens;
     ChanCtrl chanCtrl;
     TevSwapModeTable swapModeTable;
-    std::vector<TextureTransform> indirectTransforms;
-    std::vector<IndirectStage> indirectStages;
+    SmallVector<TextureTransform, MAX_INDIRECT_TRANSFORMS> indirectTransforms;
+    SmallVector<IndirectStage, MAX_INDIRECT_STAGES> indirectStages;
     std::uint32_t flags;
-    BitField<std::uint32_t> hasMaterialColor = BitField(flags, 4, 1);
-    BitField<std::uint32_t> hasChannelControl = BitField(flags, 6, 1);
-    BitField<std::uint32_t> hasBlendMode = BitField(flags, 7, 1);
-    BitField<std::uint32_t> hasAlphaCompare = BitField(flags, 8, 1);
-    BitField<std::uint32_t> tevStagesCount = BitField(flags, 9, 5);
-    BitField<std::uint32_t> indTexOrderCount = BitField(flags, 14, 3);
-    BitField<std::uint32_t> indSrtCount = BitField(flags, 17, 2);
-    BitField<std::uint32_t> hasTevSwapTable = BitField(flags, 19, 1);
-    BitField<std::uint32_t> texCoordGenCount = BitField(flags, 20, 4);
-    BitField<std::uint32_t> mtxCount = BitField(flags, 24, 4);
-    BitField<std::uint32_t> texCount = BitField(flags, 28, 4);
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    // accessors for the fields packed into flags
+    constexpr bool hasMaterialColor() const { return BitRange<std::uint32_t, 4, 1>::get(flags); };
+    constexpr void setHasMaterialColor(bool value) { flags = BitRange<std::uint32_t, 4, 1>::set(flags, value); };
+    constexpr bool hasChannelControl() const { return BitRange<std::uint32_t, 6, 1>::get(flags); };
+    constexpr void setHasChannelControl(bool value) { flags = BitRange<std::uint32_t, 6, 1>::set(flags, value); };
+    constexpr bool hasBlendMode() const { return BitRange<std::uint32_t, 7, 1>::get(flags); };
+    constexpr void setHasBlendMode(bool value) { flags = BitRange<std::uint32_t, 7, 1>::set(flags, value); };
+    constexpr bool hasAlphaCompare() const { return BitRange<std::uint32_t, 8, 1>::get(flags); };
+    constexpr void setHasAlphaCompare(bool value) { flags = BitRange<std::uint32_t, 8, 1>::set(flags, value); };
+    constexpr std::uint32_t tevStagesCount() const { return BitRange<std::uint32_t, 9, 5>::get(flags); };
+    constexpr void setTevStagesCount(std::uint32_t value) { flags = BitRange<std::uint32_t, 9, 5>::set(flags, value); };
+    constexpr std::uint32_t indTexOrderCount() const { return BitRange<std::uint32_t, 14, 3>::get(flags); };
+    constexpr void setIndTexOrderCount(std::uint32_t value) { flags = BitRange<std::uint32_t, 14, 3>::set(flags, value); };
+    constexpr std::uint32_t indSrtCount() const { return BitRange<std::uint32_t, 17, 2>::get(flags); };
+    constexpr void setIndSrtCount(std::uint32_t value) { flags = BitRange<std::uint32_t, 17, 2>::set(flags, value); };
+    constexpr bool hasTevSwapTable() const { return BitRange<std::uint32_t, 19, 1>::get(flags); };
+    constexpr void setHasTevSwapTable(bool value) { flags = BitRange<std::uint32_t, 19, 1>::set(flags, value); };
+    constexpr std::uint32_t texCoordGenCount() const { return BitRange<std::uint32_t, 20, 4>::get(flags); };
+    constexpr void setTexCoordGenCount(std::uint32_t value) { flags = BitRange<std::uint32_t, 20, 4>::set(flags, value); };
+    constexpr std::uint32_t mtxCount() const { return BitRange<std::uint32_t, 24, 4>::get(flags); };
+    constexpr void setMtxCount(std::uint32_t value) { flags = BitRange<std::uint32_t, 24, 4>::set(flags, value); };
+    constexpr std::uint32_t texCount() const { return BitRange<std::uint32_t, 28, 4>::get(flags); };
+    constexpr void setTexCount(std::uint32_t value) { flags = BitRange<std::uint32_t, 28, 4>::set(flags, value); };
+    /**
+     * @brief file bytes of a lazily read material, empty once it is decoded
+     */
+    std::string_view encoded;
+    /**
+     * @brief keeps the arena holding encoded alive, so copies outlive the document they were read from
+     */
+    std::shared_ptr<Arena> encodedArena;
+    bool encodedRevEndian = false;
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    /**
+     * @brief reads the name, flags and texture maps and keeps the rest encoded in the header's arena
+     */
+    template<Endian E>
+    void readLazy(BinaryReader &stream, const BaseHeader &header);
+    /**
+     * @brief decodes a lazily read material, keeping its name, flags and texture maps
+     */
+    void decode();
+    bool isDecoded() const { return encoded.empty(); };
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size() const;
+    private:
+    template<Endian E>
+    void readColors(BinaryReader &stream);
+    // everything after the texture maps
+    template<Endian E>
+    void readStages(BinaryReader &stream);
+};
+
+/**
+ * @brief shared material pointer that decodes a lazily read material when it is dereferenced
+ *
+ * Reads and edits through -> and * therefore always see the real fields.
+ * get() leaves the material encoded, which is how the writers copy untouched
+ * materials verbatim. Decoding is not synchronized, so call decodeMaterials
+ * before sharing a lazily read layout between threads.
+ */
+struct MaterialPtr : std::shared_ptr<Material> {
+    using std::shared_ptr<Material>::shared_ptr;
+    MaterialPtr(std::shared_ptr<Material> material) : std::shared_ptr<Material>(std::move(material)) {};
+    Material &operator*() const { return *operator->(); };
+    Material *operator->() const {
+        auto material = get();
+        if (!material->isDecoded()) {
+            material->decode();
+        }
+        return material;
+    };
 };
 
 struct Mat1 : Section {
-    static inline const std::string MAGIC = "mat1";
-    std::vector<std::shared_ptr<Material>> materials;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    static constexpr std::string_view MAGIC = "mat1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
+    std::vector<MaterialPtr> materials;
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 #if 0
@@ -211,48 +296,71 @@ enum class UsdType : std::uint8_t {
 struct UsdEntry {
     std::string name;
     std::variant<std::string, std::vector<std::uint32_t>, std::vector<float>> data;
-    void read(std::istream &stream, bool revEndian);
+    void read(BinaryReader &stream, bool revEndian);
     void write(std::ostream &stream, bool revEndian);
 };
 #endif
 
 struct Usd1 : Section {
-    static inline const std::string MAGIC = "usd1";
+    static constexpr std::string_view MAGIC = "usd1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     std::uint32_t sectionSize;
     std::vector<char> data; // TODO parse the data
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    /**
+     * @brief byte order mark of the document data was read from, 0 if it is in the writer's order
+     *
+     * Writing to a document with the other byte order swaps the numbers in data.
+     */
+    std::uint16_t bom = 0;
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 struct Pan1 : BasePane {
-    static inline const std::string MAGIC = "pan1";
+    static constexpr std::string_view MAGIC = "pan1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     static inline const std::array<OriginX, 3> ORIGIN_X_MAP = {OriginX::LEFT, OriginX::CENTER, OriginX::RIGHT};
     static inline const std::array<OriginY, 3> ORIGIN_Y_MAP = {OriginY::TOP, OriginY::CENTER, OriginY::BOTTOM};
     std::uint8_t flags;
     std::optional<Usd1> userData;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
-    virtual std::string signature();
+    Pan1() : BasePane(PaneKind::Pane) {};
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
+    virtual std::string_view signature();
+    protected:
+    explicit Pan1(PaneKind kind) : BasePane(kind) {};
 };
 
 struct Pic1 : Pan1 {
-    static inline const std::string MAGIC = "pic1";
-    std::vector<TexCoord> texCoords;
+    static constexpr std::string_view MAGIC = "pic1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
+    SmallVector<TexCoord, 1> texCoords;
     color8 colorTopLeft;
     color8 colorTopRight;
     color8 colorBottomLeft;
     color8 colorBottomRight;
-    std::shared_ptr<Material> material;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
-    virtual std::string signature();
+    MaterialPtr material;
+    Pic1() : Pan1(PaneKind::Picture) {};
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
+    virtual std::string_view signature();
 };
 
 struct Txt1 : Pan1 {
-    static inline const std::string MAGIC = "txt1";
+    static constexpr std::string_view MAGIC = "txt1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     std::uint16_t textLen;
     std::uint16_t maxTextLen;
-    std::shared_ptr<Material> material;
+    MaterialPtr material;
     std::string font;
     std::uint8_t textAlign;
     LineAlign lineAlign;
@@ -264,30 +372,44 @@ struct Txt1 : Pan1 {
     float lineSpace;
     std::u16string text;
     std::uint8_t flagsTxt1;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
-    virtual std::string signature();
+    Txt1() : Pan1(PaneKind::Text) {};
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
+    virtual std::string_view signature();
 };
 
 struct Bnd1 : Pan1 {
-    static inline const std::string MAGIC = "bnd1";
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
-    virtual std::string signature();
+    static constexpr std::string_view MAGIC = "bnd1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
+    Bnd1() : Pan1(PaneKind::Bounding) {};
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    virtual std::string_view signature();
 };
 
-struct WindowContent : BaseWindowContent<Material> {
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+struct WindowContent : BaseWindowContent<MaterialPtr> {
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size() const;
 };
 
-struct WindowFrame : BaseWindowFrame<Material> {
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+struct WindowFrame : BaseWindowFrame<MaterialPtr> {
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
 };
 
 struct Wnd1 : Pan1 {
-    static inline const std::string MAGIC = "wnd1";
+    static constexpr std::string_view MAGIC = "wnd1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     std::uint16_t stretchLeft;
     std::uint16_t stretchRight;
     std::uint16_t stretchTop;
@@ -299,24 +421,195 @@ struct Wnd1 : Pan1 {
     std::uint8_t flagsWnd1;
     WindowContent content;
     std::vector<WindowFrame> frames;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
-    virtual std::string signature();
+    Wnd1() : Pan1(PaneKind::Window) {};
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
+    virtual std::string_view signature();
 };
 
-struct Grp1 : GroupPane {
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
-};
+// groups have no layout-specific fields, so GroupPane reads and writes them
+struct Grp1 : GroupPane {};
+
+/**
+ * @brief calls f with pane cast to its concrete type, found from pane.kind
+ *
+ * f must accept every pane type, e.g. a generic lambda, and return the same
+ * type for all of them.
+ */
+template<class F>
+decltype(auto) visitPane(BasePane &pane, F &&f) {
+    switch (pane.kind) {
+    case PaneKind::Picture:
+        return f(static_cast<Pic1 &>(pane));
+    case PaneKind::Text:
+        return f(static_cast<Txt1 &>(pane));
+    case PaneKind::Bounding:
+        return f(static_cast<Bnd1 &>(pane));
+    case PaneKind::Window:
+        return f(static_cast<Wnd1 &>(pane));
+    default:
+        return f(static_cast<Pan1 &>(pane));
+    }
+}
+
+template<class F>
+decltype(auto) visitPane(const BasePane &pane, F &&f) {
+    switch (pane.kind) {
+    case PaneKind::Picture:
+        return f(static_cast<const Pic1 &>(pane));
+    case PaneKind::Text:
+        return f(static_cast<const Txt1 &>(pane));
+    case PaneKind::Bounding:
+        return f(static_cast<const Bnd1 &>(pane));
+    case PaneKind::Window:
+        return f(static_cast<const Wnd1 &>(pane));
+    default:
+        return f(static_cast<const Pan1 &>(pane));
+    }
+}
 
 struct Brlyt : BaseHeader {
-    static inline const std::string MAGIC = "RLYT";
+    static constexpr std::string_view MAGIC = "RLYT";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     Lyt1 lyt1;
     Txl1<true> txl1;
     Mat1 mat1;
     Fnl1<true> fnl1;
+    /**
+     * @brief every pane under rootPane by name, kept up to date by addPane and removePane
+     */
+    std::unordered_map<FixedName<0x10>, std::shared_ptr<BasePane>, FixedName<0x10>::Hash> paneTable;
+    /**
+     * @brief returns the pane with the given name or nullptr
+     */
+    std::shared_ptr<BasePane> findPane(const FixedName<0x10> &name) const;
+    std::shared_ptr<BasePane> findPane(std::string_view name) const;
+    /**
+     * @brief returns the pane an animation entry targets or nullptr
+     */
+    template<class TagType>
+    std::shared_ptr<BasePane> findPane(const BasePaiEntry<TagType> &entry) const {
+        if (entry.target != AnimationTarget::Pane) {
+            return nullptr;
+        }
+        return findPane(entry.name);
+    };
+    /**
+     * @brief resolves the pane names of a group, skipping names that do not exist
+     */
+    std::vector<std::shared_ptr<BasePane>> findPanes(const GroupPane &group) const;
+    /**
+     * @brief attaches pane and its children under parent and indexes them
+     *
+     * A null parent makes pane the new rootPane. A pane that is already in the
+     * tree is moved, and adding a pane below itself throws std::invalid_argument.
+     */
+    void addPane(const std::shared_ptr<BasePane> &pane, const std::shared_ptr<BasePane> &parent);
+    /**
+     * @brief detaches pane from its parent and drops it and its children from the index
+     */
+    void removePane(const std::shared_ptr<BasePane> &pane);
+    /**
+     * @brief renames pane and updates the index
+     *
+     * Throws std::invalid_argument and leaves everything unchanged if another
+     * pane already has the name.
+     */
+    void renamePane(const std::shared_ptr<BasePane> &pane, std::string_view name);
+    /**
+     * @brief re-indexes the whole tree after rootPane was modified directly
+     */
+    void rebuildPaneTable();
+    /**
+     * @brief index of a material in mat1, or the material count if it is missing
+     */
+    std::uint16_t materialIndex(const std::shared_ptr<Material> &material) const;
+    /**
+     * @brief index of a texture name in txl1, or the texture count if it is missing
+     */
+    std::uint16_t textureIndex(const std::string &name) const;
+    /**
+     * @brief index of a font name in fnl1, or the font count if it is missing
+     */
+    std::uint16_t fontIndex(const std::string &name) const;
+    /**
+     * @brief merges materials that serialize to the same bytes and returns the bytes saved
+     *
+     * Panes are repointed to the first material of each set of equal ones. With
+     * ignoreNames, materials that only differ in name are merged as well, so
+     * animations targeting the dropped names no longer apply.
+     */
+    std::uint32_t dedupMaterials(bool ignoreNames = false);
+    /**
+     * @brief decodes every material that was read lazily
+     */
+    void decodeMaterials();
+    /**
+     * @brief reads the file from the current position of the stream to its end
+     */
     void read(std::istream &stream);
+    /**
+     * @brief reads the file from a buffer that is already in memory
+     */
+    void read(const char *data, std::size_t size);
+    void read(BinaryReader &stream);
+    /**
+     * @brief reads the file header and lists the sections without decoding them
+     */
+    std::vector<SectionEntry> scan(BinaryReader &stream);
+    /**
+     * @brief decodes the lyt1, txl1, fnl1 or mat1 section at a directory entry
+     *
+     * The section replaces what was read into it before, so reading it twice
+     * does not duplicate its materials.
+     */
+    void readSection(BinaryReader &stream, const SectionEntry &entry);
+    /**
+     * @brief decodes the pane at directory[index] on its own, without its children
+     *
+     * txl1, fnl1 and mat1 are read from the directory first if they are still
+     * empty, and a usd1 section right after the pane is attached as user data.
+     * The pane is standalone: it has no parent or children and is not put in
+     * paneTable, so use addPane to place it in the tree.
+     */
+    std::shared_ptr<BasePane> readPane(BinaryReader &stream, const std::vector<SectionEntry> &directory, std::size_t index);
+    /**
+     * @brief memory-maps the file at path read-only and parses it in place
+     */
+    void loadFile(const std::string &path);
     void write(std::ostream &stream);
+    void write(BinaryWriter &stream);
+    /**
+     * @brief serializes the file into a single buffer of exactly its size
+     */
+    std::vector<char> serialize();
+    private:
+    /**
+     * @brief hash lookups for the index functions, only populated while writing
+     */
+    struct WriteIndex {
+        std::unordered_map<const Material *, std::uint16_t> materials;
+        std::unordered_map<std::string_view, std::uint16_t> textures;
+        std::unordered_map<std::string_view, std::uint16_t> fonts;
+    } writeIndex;
+    bool writeIndexBuilt = false;
+    void buildWriteIndex();
+    void clearWriteIndex();
+    /**
+     * @brief keeps the write index built for its lifetime, so a throwing writer cannot leave it stale
+     */
+    class WriteIndexScope {
+        public:
+        explicit WriteIndexScope(Brlyt &layout) : layout(layout) { layout.buildWriteIndex(); };
+        ~WriteIndexScope() { layout.clearWriteIndex(); };
+        WriteIndexScope(const WriteIndexScope &other) = delete;
+        WriteIndexScope &operator=(const WriteIndexScope &other) = delete;
+        private:
+        Brlyt &layout;
+    };
 };
 
 }
@@ -1,240 +1,545 @@
 #include "common.h"
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BECQUEREL_SSE2
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define BECQUEREL_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define BECQUEREL_AVX2
+#endif
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace bq {
 
-void Section::read(std::istream &stream, const BaseHeader &header) {
-    // nothing to do
-}
-void Section::write(std::ostream &stream, const BaseHeader &header) {
-    // nothing to do
+std::uint32_t Section::size(const BaseHeader &) {
+    return 0;
 }
 Section::~Section() = default;
 
-std::string GroupPane::signature() {
+std::string_view GroupPane::signature() {
     return GroupPane::MAGIC;
 }
 
+template<Endian E>
+void GroupPane::read(BinaryReader &stream, const BaseHeader &) {
+    name = readFixedName<0x10>(stream);
+    auto numNodes = readNumber<std::uint16_t, E>(stream);
+    stream.seekg(2, std::ios::cur);
+    panes.reserve(panes.size() + numNodes);
+    for (int i=0; i<numNodes; ++i) {
+        panes.push_back(readFixedName<0x10>(stream));
+    }
+}
+
+template<Endian E>
+void GroupPane::write(BinaryWriter &stream, const BaseHeader &) {
+    writeFixedName(name, stream);
+    writeNumber<E>((std::uint16_t)panes.size(), stream);
+    stream.put('\0');
+    stream.put('\0');
+    for (auto &node: panes) {
+        writeFixedName(node, stream);
+    }
+}
+
+std::uint32_t GroupPane::size(const BaseHeader &) {
+    return 0x14 + panes.size() * 0x10;
+}
+
+template void GroupPane::read<Endian::Big>(BinaryReader &stream, const BaseHeader &header);
+template void GroupPane::read<Endian::Little>(BinaryReader &stream, const BaseHeader &header);
+template void GroupPane::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void GroupPane::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+
 bool BaseHeader::revEndian() const { return bom != 0xfeff; }
 
-static std::vector<std::string> readStringList(std::istream &stream, bool revEndian, bool padding) {
+std::uint16_t BaseHeader::readFileHeader(BinaryReader &stream, std::string_view magic) {
+    stream.seekg(0);
+    auto fileMagic = readFixedStrView(stream, 4);
+    if (fileMagic != magic) {
+        // TODO throw exception here
+    }
+    bom = readNumber<std::uint16_t>(stream, false);
+    bool reverseEndian = revEndian();
+    version = readNumber<std::uint16_t>(stream, reverseEndian);
+    readNumber<std::uint32_t>(stream, reverseEndian); // file size
+    headerSize = readNumber<std::uint16_t>(stream, reverseEndian);
+    return readNumber<std::uint16_t>(stream, reverseEndian);
+}
+
+std::vector<SectionEntry> BaseHeader::scanSections(BinaryReader &stream, std::string_view magic) {
+    auto sectionCount = readFileHeader(stream, magic);
+    std::vector<SectionEntry> directory;
+    directory.reserve(sectionCount);
+    std::uint32_t offset = headerSize;
+    std::uint32_t depth = 0;
+    withEndian(revEndian(), [&](auto endian) {
+        for (int i=0; i<sectionCount; ++i) {
+            stream.seekg(offset);
+            auto sectionMagic = readNumber<std::uint32_t, Endian::Big>(stream);
+            auto size = readNumber<std::uint32_t, decltype(endian)::value>(stream);
+            if (size < 8 || size > stream.size() - offset) {
+                throw std::out_of_range("section extends past the end of the file");
+            }
+            if ((sectionMagic == fourcc(PANE_END_MAGIC) || sectionMagic == fourcc(GROUP_END_MAGIC)) && depth > 0) {
+                --depth;
+            }
+            directory.push_back({sectionMagic, offset, size, depth});
+            if (sectionMagic == fourcc(PANE_START_MAGIC) || sectionMagic == fourcc(GROUP_START_MAGIC)) {
+                ++depth;
+            }
+            offset += size;
+        }
+    });
+    return directory;
+}
+
+const SectionEntry *findSection(const std::vector<SectionEntry> &directory, std::uint32_t magic, std::size_t nth) {
+    for (auto &entry: directory) {
+        if (entry.magic == magic && nth-- == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+SectionObserver::~SectionObserver() = default;
+
+void SectionHistogram::onSection(const SectionStats &stats) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &entry = entries[{stats.magic, stats.write}];
+    ++entry.count;
+    entry.bytes += stats.size;
+    entry.nanoseconds += stats.nanoseconds;
+    entry.maxNanoseconds = std::max(entry.maxNanoseconds, stats.nanoseconds);
+    entry.allocations += stats.allocations;
+    auto bucket = std::upper_bound(BUCKET_LIMITS.begin(), BUCKET_LIMITS.end(), stats.nanoseconds) - BUCKET_LIMITS.begin();
+    ++entry.buckets[bucket];
+}
+
+void SectionHistogram::print(std::ostream &stream) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<std::pair<std::uint32_t, bool>, Entry>> sorted(entries.begin(), entries.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) {
+        return a.second.nanoseconds > b.second.nanoseconds;
+    });
+    // without a counter every section would report 0 allocations, so the column is left out
+    bool allocations = bool(allocationCounter);
+    char line[256];
+    int length = std::snprintf(line, sizeof(line), "%-10s %9s %12s %10s %10s %10s",
+        "section", "count", "bytes", "total ms", "mean us", "max us");
+    if (allocations) {
+        length += std::snprintf(line + length, sizeof(line) - length, " %9s", "allocs");
+    }
+    std::snprintf(line + length, sizeof(line) - length, " %8s %8s %8s %8s %8s %8s\n",
+        "<1us", "<10us", "<100us", "<1ms", "<10ms", ">=10ms");
+    stream << line;
+    for (auto &[key, entry]: sorted) {
+        auto [magic, write] = key;
+        char name[5] = {char(magic >> 24), char(magic >> 16), char(magic >> 8), char(magic), '\0'};
+        length = std::snprintf(line, sizeof(line), "%-5s %4s %9llu %12llu %10.3f %10.3f %10.3f",
+            write ? "write" : "read", name, (unsigned long long)entry.count, (unsigned long long)entry.bytes,
+            entry.nanoseconds / 1e6, entry.nanoseconds / 1e3 / entry.count, entry.maxNanoseconds / 1e3);
+        if (allocations) {
+            length += std::snprintf(line + length, sizeof(line) - length, " %9.1f", double(entry.allocations) / entry.count);
+        }
+        for (auto count: entry.buckets) {
+            length += std::snprintf(line + length, sizeof(line) - length, " %8llu", (unsigned long long)count);
+        }
+        stream << line << '\n';
+    }
+}
+
+void parallelFor(std::size_t count, unsigned threads, const std::function<void(std::size_t)> &f) {
+    // below this many items per thread, starting threads costs more than it saves
+    constexpr std::size_t MIN_ITEMS_PER_THREAD = 16;
+    constexpr std::size_t BLOCK_SIZE = 4;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<std::size_t>(threads, count / MIN_ITEMS_PER_THREAD);
+    if (threads <= 1) {
+        for (std::size_t i=0; i<count; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&] {
+        try {
+            for (;;) {
+                auto begin = next.fetch_add(BLOCK_SIZE);
+                if (begin >= count) {
+                    break;
+                }
+                auto end = std::min(begin + BLOCK_SIZE, count);
+                for (auto i=begin; i<end; ++i) {
+                    f(i);
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next = count;
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned i=1; i<threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+Arena::Arena(std::size_t initialChunkSize) : nextChunkSize(std::max<std::size_t>(initialChunkSize, 0x100)) {}
+
+Arena::~Arena() {
+    while (chunks) {
+        auto next = chunks->next;
+        ::operator delete(chunks);
+        chunks = next;
+    }
+}
+
+void *Arena::allocate(std::size_t size, std::size_t alignment) {
+    auto aligned = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(std::uintptr_t(alignment) - 1));
+    if (!cursor || aligned + size > chunkEnd) {
+        // chunks double in size, and an oversized request gets a chunk of its own
+        auto chunkSize = std::max(nextChunkSize, size + alignment + sizeof(Chunk));
+        auto chunk = static_cast<Chunk *>(::operator new(chunkSize));
+        chunk->next = chunks;
+        chunks = chunk;
+        chunkBytes += chunkSize;
+        cursor = reinterpret_cast<char *>(chunk + 1);
+        chunkEnd = reinterpret_cast<char *>(chunk) + chunkSize;
+        nextChunkSize *= 2;
+        aligned = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(std::uintptr_t(alignment) - 1));
+    }
+    cursor = aligned + size;
+    return aligned;
+}
+
+template<Endian E>
+static std::vector<std::string> readStringList(BinaryReader &stream, bool padding) {
     std::vector<std::string> result;
-    auto count = readNumber<std::uint16_t>(stream, revEndian);
+    auto count = readNumber<std::uint16_t, E>(stream);
     stream.seekg(2, std::ios::cur); // padding
     auto pos = stream.tellg();
+    result.reserve(count);
     for (int i=0; i<count; ++i) {
-        auto off = readNumber<std::uint32_t>(stream, revEndian);
+        auto off = readNumber<std::uint32_t, E>(stream);
         if (padding) stream.seekg(4, std::ios::cur);
         {
             TemporarySeekI ts(stream, pos + std::streamoff(off));
-            result.push_back(readNullTerminatedStr(stream));
+            result.emplace_back(readNullTerminatedStrView(stream));
         }
     }
     return result;
 }
 
-static void writeStringList(const std::vector<std::string> &list, std::ostream &stream, bool revEndian, bool padding) {
-    writeNumber((std::uint16_t)list.size(), stream, revEndian);
-    stream.put('\0');
-    stream.put('\0');
-    auto pos = stream.tellp();
-    std::streamoff firstOff = list.size() * sizeof(uint32_t) * (padding ? 2 : 1);
-    auto pos2 = pos + firstOff;
-    for (int i=0; i<firstOff; ++i) {
-        stream.put('\0');
+static std::uint32_t stringListSize(const std::vector<std::string> &list, bool padding) {
+    std::uint32_t size = 4 + list.size() * sizeof(std::uint32_t) * (padding ? 2 : 1);
+    for (auto &item: list) {
+        size += item.size() + 1;
     }
-    stream.seekp(pos);
+    return size;
+}
 
+template<Endian E>
+static void writeStringList(const std::vector<std::string> &list, BinaryWriter &stream, bool padding) {
+    writeNumber<E>((std::uint16_t)list.size(), stream);
+    stream.put('\0');
+    stream.put('\0');
+    std::uint32_t off = list.size() * sizeof(uint32_t) * (padding ? 2 : 1);
     for (auto &item: list) {
-        writeNumber(std::uint32_t(pos2 - pos), stream, revEndian);
+        writeNumber<E>(off, stream);
         if (padding) {
             stream.write("\0\0\0\0", 4);
         }
-
-        {
-            TemporarySeekO ts(stream, pos2);
-            writeNullTerminatedStr(item, stream);
-            pos2 = stream.tellp();
-        }
+        off += item.size() + 1;
+    }
+    for (auto &item: list) {
+        writeNullTerminatedStr(item, stream);
     }
-    stream.seekp(pos2); // seek to end of allocated strings
 }
 
 template<bool padding>
-void Txl1<padding>::read(std::istream &stream, const BaseHeader &header) {
-    textures = readStringList(stream, header.revEndian(), padding);
+template<Endian E>
+void Txl1<padding>::read(BinaryReader &stream, const BaseHeader &) {
+    textures = readStringList<E>(stream, padding);
 }
 
 template<bool padding>
-void Txl1<padding>::write(std::ostream &stream, const BaseHeader &header) {
-    writeStringList(textures, stream, header.revEndian(), padding);
+template<Endian E>
+void Txl1<padding>::write(BinaryWriter &stream, const BaseHeader &) {
+    writeStringList<E>(textures, stream, padding);
 }
 
 template<bool padding>
-void Fnl1<padding>::read(std::istream &stream, const BaseHeader &header) {
-    fonts = readStringList(stream, header.revEndian(), padding);
+std::uint32_t Txl1<padding>::size(const BaseHeader &) {
+    return stringListSize(textures, padding);
 }
 
 template<bool padding>
-void Fnl1<padding>::write(std::ostream &stream, const BaseHeader &header) {
-    writeStringList(fonts, stream, header.revEndian(), padding);
-}
-
-void TextureTransform::read(std::istream &stream, bool revEndian) {
-    translate.read(stream, revEndian);
-    rotate = readNumber<float>(stream, revEndian);
-    scale.read(stream, revEndian);
-}
-
-void TextureTransform::write(std::ostream &stream, bool revEndian) {
-    translate.write(stream, revEndian);
-    writeNumber(rotate, stream, revEndian);
-    scale.write(stream, revEndian);
+template<Endian E>
+void Fnl1<padding>::read(BinaryReader &stream, const BaseHeader &) {
+    fonts = readStringList<E>(stream, padding);
 }
 
-void BlendMode::read(std::istream &stream, bool revEndian) {
-    blendOp = (Op)readNumber<std::uint8_t>(stream, revEndian);
-    srcFactor = (BlendFactor)readNumber<std::uint8_t>(stream, revEndian);
-    destFactor = (BlendFactor)readNumber<std::uint8_t>(stream, revEndian);
-    logicOp = (Op)readNumber<std::uint8_t>(stream, revEndian);
+template<bool padding>
+template<Endian E>
+void Fnl1<padding>::write(BinaryWriter &stream, const BaseHeader &) {
+    writeStringList<E>(fonts, stream, padding);
 }
 
-void BlendMode::write(std::ostream &stream, bool revEndian) {
-    writeNumber((std::uint8_t)blendOp, stream, revEndian);
-    writeNumber((std::uint8_t)srcFactor, stream, revEndian);
-    writeNumber((std::uint8_t)destFactor, stream, revEndian);
-    writeNumber((std::uint8_t)logicOp, stream, revEndian);
+template<bool padding>
+std::uint32_t Fnl1<padding>::size(const BaseHeader &) {
+    return stringListSize(fonts, padding);
 }
 
-void KeyFrame::read(std::istream &stream, bool revEndian, CurveType curveType) {
-    if (curveType == CurveType::Hermite) {
-        frame = readNumber<float>(stream, revEndian);
-        value = readNumber<float>(stream, revEndian);
-        slope = readNumber<float>(stream, revEndian);
-    } else {
-        frame = readNumber<float>(stream, revEndian);
-        value = readNumber<std::uint16_t>(stream, revEndian);
-        stream.seekg(2, std::ios::cur);
-    }
-}
+template void Txl1<true>::read<Endian::Big>(BinaryReader &stream, const BaseHeader &header);
+template void Txl1<true>::read<Endian::Little>(BinaryReader &stream, const BaseHeader &header);
+template void Txl1<true>::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Txl1<true>::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
+template void Fnl1<true>::read<Endian::Big>(BinaryReader &stream, const BaseHeader &header);
+template void Fnl1<true>::read<Endian::Little>(BinaryReader &stream, const BaseHeader &header);
+template void Fnl1<true>::write<Endian::Big>(BinaryWriter &stream, const BaseHeader &header);
+template void Fnl1<true>::write<Endian::Little>(BinaryWriter &stream, const BaseHeader &header);
 
-void KeyFrame::write(std::ostream &stream, bool revEndian, CurveType curveType) {
-    if (curveType == CurveType::Hermite) {
-        writeNumber(frame, stream, revEndian);
-        writeNumber(value, stream, revEndian);
-        writeNumber(slope, stream, revEndian);
-    } else {
-        writeNumber(frame, stream, revEndian);
-        writeNumber((std::uint16_t)value, stream, revEndian);
-        stream.put('\0');
-        stream.put('\0');
-    }
-}
-
-void PaiTagEntry::read(std::istream &stream, bool revEndian) {
+template<Endian E>
+void PaiTagEntry::read(BinaryReader &stream) {
     auto pos = stream.tellg();
-    index = readNumber<std::uint8_t>(stream, revEndian);
-    target = readNumber<std::uint8_t>(stream, revEndian);
-    curveType = (CurveType)readNumber<std::uint8_t>(stream, revEndian);
+    index = readNumber<std::uint8_t, E>(stream);
+    target = readNumber<std::uint8_t, E>(stream);
+    curveType = (CurveType)readNumber<std::uint8_t, E>(stream);
     stream.seekg(1, std::ios::cur);
-    auto keyFrameCount = readNumber<std::uint16_t>(stream, revEndian);
+    auto keyFrameCount = readNumber<std::uint16_t, E>(stream);
     stream.seekg(2, std::ios::cur);
-    auto keyFrameOff = readNumber<std::uint32_t>(stream, revEndian);
+    auto keyFrameOff = readNumber<std::uint32_t, E>(stream);
     stream.seekg(pos + std::streamoff(keyFrameOff));
     keyFrames.resize(keyFrameCount);
+    if (curveType == CurveType::Hermite) {
+        // hermite keys are stored as three packed floats, like KeyFrame
+        readArray<E>(stream, reinterpret_cast<float *>(keyFrames.data()), keyFrames.size() * 3);
+        return;
+    }
     for (auto &keyFrame: keyFrames) {
-        keyFrame.read(stream, revEndian, curveType);
+        keyFrame.read<E>(stream, curveType);
     }
 }
 
-void PaiTagEntry::write(std::ostream &stream, bool revEndian) {
-    writeNumber(index, stream, revEndian);
-    writeNumber(target, stream, revEndian);
-    writeNumber((std::uint8_t)curveType, stream, revEndian);
+template<Endian E>
+void PaiTagEntry::write(BinaryWriter &stream) {
+    writeNumber<E>(index, stream);
+    writeNumber<E>(target, stream);
+    writeNumber<E>((std::uint8_t)curveType, stream);
     stream.put('\0');
-    writeNumber((std::uint16_t)keyFrames.size(), stream, revEndian);
+    writeNumber<E>((std::uint16_t)keyFrames.size(), stream);
     stream.put('\0');
     stream.put('\0');
-    writeNumber(std::uint32_t(0x0c), stream, revEndian);
+    writeNumber<E>(std::uint32_t(0x0c), stream);
+    if (curveType == CurveType::Hermite) {
+        writeArray<E>(reinterpret_cast<const float *>(keyFrames.data()), keyFrames.size() * 3, stream);
+        return;
+    }
     for (auto &keyFrame: keyFrames) {
-        keyFrame.write(stream, revEndian, curveType);
+        keyFrame.write<E>(stream, curveType);
     }
 }
 
-std::string readFixedStr(std::istream &stream, int len) {
-    std::string res(len, '\0');
-    stream.read(res.data(), len);
-    while (!res.empty() && res.back() == '\0') {
-        res.pop_back();
+template void PaiTagEntry::read<Endian::Big>(BinaryReader &stream);
+template void PaiTagEntry::read<Endian::Little>(BinaryReader &stream);
+template void PaiTagEntry::write<Endian::Big>(BinaryWriter &stream);
+template void PaiTagEntry::write<Endian::Little>(BinaryWriter &stream);
+
+template<class T>
+static void byteswapScalar(char *data, std::size_t count) {
+    for (std::size_t i=0; i<count; ++i) {
+        T value;
+        std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+        value = byteswap(value);
+        std::memcpy(data + i * sizeof(T), &value, sizeof(T));
     }
-    return res;
 }
 
-void writeFixedStr(const std::string &str, std::ostream &stream, int len) {
-    int toWriteFromStr = std::min((int)str.size(), len);
-    stream.write(str.data(), toWriteFromStr);
-    for (int i=0; i<len - toWriteFromStr; ++i) {
-        stream.put('\0');
+#ifdef BECQUEREL_SSE2
+// swaps whole 16 byte blocks and returns the number of bytes processed
+static std::size_t byteswapSse2(char *data, std::size_t bytes, std::size_t elementSize) {
+    std::size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (elementSize >= 8) {
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        if (elementSize >= 4) {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), v);
+    }
+    return i;
+}
+
+#ifdef BECQUEREL_AVX2
+BECQUEREL_AVX2 static std::size_t byteswapAvx2(char *data, std::size_t bytes, std::size_t elementSize) {
+    const __m256i mask16 = _mm256_setr_epi8(
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i mask32 = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i mask64 = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i mask = elementSize == 2 ? mask16 : elementSize == 4 ? mask32 : mask64;
+    std::size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_shuffle_epi8(v, mask));
     }
+    return i;
 }
 
-std::string readNullTerminatedStr(std::istream &stream) {
-    std::string res;
-    std::getline(stream, res, '\0');
-    return res;
+static bool hasAvx2() {
+#if defined(__AVX2__)
+    return true;
+#elif defined(__GNUC__) || defined(__clang__)
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+#else
+    static const bool result = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return result;
+#endif
 }
+#endif
+#endif
 
-void writeNullTerminatedStr(const std::string &str, std::ostream &stream) {
-    stream.write(str.data(), str.length() + 1);
+void byteswapArray(char *data, std::size_t count, std::size_t elementSize) {
+    if (elementSize <= 1) {
+        return;
+    }
+    std::size_t bytes = count * elementSize;
+    std::size_t done = 0;
+#ifdef BECQUEREL_SSE2
+#ifdef BECQUEREL_AVX2
+    if (hasAvx2()) {
+        done = byteswapAvx2(data, bytes, elementSize);
+    }
+#endif
+    done += byteswapSse2(data + done, bytes - done, elementSize);
+#endif
+    std::size_t rest = (bytes - done) / elementSize;
+    switch (elementSize) {
+        case 2: byteswapScalar<std::uint16_t>(data + done, rest); break;
+        case 4: byteswapScalar<std::uint32_t>(data + done, rest); break;
+        case 8: byteswapScalar<std::uint64_t>(data + done, rest); break;
+        default: throw std::invalid_argument("byteswapArray: unsupported element size");
+    }
 }
 
-std::u16string readNullTerminatedStrU16(std::istream &stream, bool revEndian) {
-    std::u16string result;
-    for (;;) {
-        auto c = readNumber<std::uint16_t>(stream, revEndian);
-        if (stream.eof() || c == 0) {
-            break;
-        }
-        result.push_back(c);
-    }
-    return result;
+std::uint32_t PaiTagEntry::size() const {
+    return 0x0c + keyFrames.size() * (curveType == CurveType::Hermite ? 0xc : 0x8);
 }
 
-void writeNullTerminatedStrU16(const std::u16string &str, std::ostream &stream, bool revEndian) {
-    for (auto c: str) {
-        writeNumber((std::uint16_t)c, stream, revEndian);
+std::string_view readFixedStrView(BinaryReader &stream, int len) {
+    const char *str = stream.peek(len);
+    int strLen = len;
+    while (strLen > 0 && str[strLen - 1] == '\0') {
+        --strLen;
     }
-    stream.put('\0');
-    stream.put('\0');
+    stream.seekg(len, std::ios::cur);
+    return std::string_view(str, strLen);
 }
 
-color8 readColor8(std::istream &stream, bool reverseEndian) {
-    color8 res;
-    for (auto &colval: res) {
-        colval = readNumber<std::uint8_t>(stream, reverseEndian);
-    }
-    return res;
+std::string readFixedStr(BinaryReader &stream, int len) {
+    return std::string(readFixedStrView(stream, len));
 }
 
-void writeColor8(const color8 &color, std::ostream &stream, bool reverseEndian) {
-    for (auto colval: color) {
-        writeNumber(colval, stream, reverseEndian);
-    }
+void writeFixedStr(std::string_view str, BinaryWriter &stream, int len) {
+    int toWriteFromStr = std::min((int)str.size(), len);
+    stream.write(str.data(), toWriteFromStr);
+    stream.fill(len - toWriteFromStr);
 }
 
-color16 readColor16(std::istream &stream, bool reverseEndian) {
-    color16 res;
-    for (auto &colval: res) {
-        colval = readNumber<std::uint16_t>(stream, reverseEndian);
-    }
-    return res;
+std::string_view readNullTerminatedStrView(BinaryReader &stream) {
+    auto remaining = stream.remaining();
+    const char *str = stream.peek(remaining);
+    auto strEnd = static_cast<const char *>(std::memchr(str, '\0', remaining));
+    std::size_t strLen = strEnd ? strEnd - str : remaining;
+    stream.seekg(std::min(strLen + 1, remaining), std::ios::cur);
+    return std::string_view(str, strLen);
+}
+
+std::string readNullTerminatedStr(BinaryReader &stream) {
+    return std::string(readNullTerminatedStrView(stream));
+}
+
+void writeNullTerminatedStr(const std::string &str, BinaryWriter &stream) {
+    stream.write(str.data(), str.length() + 1);
 }
 
-void writeColor16(const color16 &color, std::ostream &stream, bool reverseEndian) {
-    for (auto colval: color) {
-        writeNumber(colval, stream, reverseEndian);
+template<Endian E>
+std::u16string readNullTerminatedStrU16(BinaryReader &stream) {
+    std::size_t maxLen = stream.remaining() / sizeof(char16_t);
+    const char *str = stream.peek(maxLen * sizeof(char16_t));
+    std::size_t len = 0;
+    while (len < maxLen && (str[2 * len] != 0 || str[2 * len + 1] != 0)) {
+        ++len;
     }
+    std::u16string result(len, u'\0');
+    readArray<E>(stream, result.data(), len);
+    if (len < maxLen) {
+        stream.seekg(sizeof(char16_t), std::ios::cur); // null terminator
+    }
+    return result;
 }
 
+template<Endian E>
+void writeNullTerminatedStrU16(const std::u16string &str, BinaryWriter &stream) {
+    writeArray<E>(str.data(), str.size(), stream);
+    stream.put('\0');
+    stream.put('\0');
+}
+
+template std::u16string readNullTerminatedStrU16<Endian::Big>(BinaryReader &stream);
+template std::u16string readNullTerminatedStrU16<Endian::Little>(BinaryReader &stream);
+template void writeNullTerminatedStrU16<Endian::Big>(const std::u16string &str, BinaryWriter &stream);
+template void writeNullTerminatedStrU16<Endian::Little>(const std::u16string &str, BinaryWriter &stream);
+
 color8 toColor8(const color16 &color) {
     color8 res;
     std::copy(color.begin(), color.end(), res.begin());
@@ -247,25 +552,96 @@ color16 toColor16(const color8 &color) {
     return res;
 }
 
-void writeSection(const std::string &magic, Section &sec, std::ostream &stream, const BaseHeader &header) {
-    bool revEndian = header.revEndian();
-    auto startPos = stream.tellp();
-    writeFixedStr(magic, stream, 4);
-    auto sectionSizePos = stream.tellp();
-    writeNumber(std::uint32_t(0), stream, revEndian);
-    sec.write(stream, header);
-    alignFile(stream);
-    auto endPos = stream.tellp();
-    {
-        TemporarySeekO ts(stream, sectionSizePos);
-        writeNumber(std::uint32_t(endPos - startPos), stream, revEndian);
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &path) {
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::system_error(GetLastError(), std::system_category(), "could not open " + path);
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        auto err = GetLastError();
+        CloseHandle(fileHandle);
+        throw std::system_error(err, std::system_category(), "could not stat " + path);
+    }
+    mappingSize = fileSize.QuadPart;
+    if (mappingSize == 0) {
+        // empty files cannot be mapped
+        return;
+    }
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle) {
+        mapping = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!mapping) {
+        auto err = GetLastError();
+        if (mappingHandle) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::system_error(err, std::system_category(), "could not map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) UnmapViewOfFile(mapping);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "could not open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "could not stat " + path);
+    }
+    mappingSize = st.st_size;
+    if (mappingSize == 0) {
+        // empty files cannot be mapped
+        close(fd);
+        return;
+    }
+    void *addr = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd); // the mapping keeps its own reference to the file
+    if (addr == MAP_FAILED) {
+        throw std::system_error(err, std::generic_category(), "could not map " + path);
     }
+#ifdef MADV_WILLNEED
+    madvise(addr, mappingSize, MADV_WILLNEED);
+#endif
+    mapping = static_cast<const char *>(addr);
 }
 
-void alignFile(std::ostream &stream) {
-    while (stream.tellp() % 4 != 0) {
-        stream.put('\0');
+MappedFile::~MappedFile() {
+    if (mapping) munmap(const_cast<char *>(mapping), mappingSize);
+}
+#endif
+
+std::vector<char> readAll(std::istream &stream) {
+    std::vector<char> result;
+    auto startPos = stream.tellg();
+    if (startPos != std::streampos(-1) && stream.seekg(0, std::ios::end)) {
+        result.resize(stream.tellg() - startPos);
+        stream.seekg(startPos);
+        stream.read(result.data(), result.size());
+    } else {
+        stream.clear();
+        result.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
     }
+    return result;
+}
+
+std::uint32_t sectionSize(Section &sec, const BaseHeader &header) {
+    return align4(8 + sec.size(header));
+}
+
+void writePadding(BinaryWriter &stream, std::size_t count) {
+    stream.fill(count);
 }
 
 }
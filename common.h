@@ -1,11 +1,20 @@
 #include <cinttypes>
+#include <cstring>
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <array>
 #include <vector>
 #include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <initializer_list>
 
 #ifndef BECQUEREL_COMMON_H
 #define BECQUEREL_COMMON_H
@@ -17,37 +26,524 @@ namespace bq {
 typedef std::array<std::uint8_t, 4> color8;
 typedef std::array<std::uint16_t, 4> color16;
 
-std::string readFixedStr(std::istream &stream, int len);
-void writeFixedStr(const std::string &str, std::ostream &stream, int len);
-std::string readNullTerminatedStr(std::istream &stream);
-void writeNullTerminatedStr(const std::string &str, std::ostream &stream);
-std::u16string readNullTerminatedStrU16(std::istream &stream, bool revEndian);
-void writeNullTerminatedStrU16(const std::u16string &str, std::ostream &stream, bool revEndian);
+/**
+ * @brief bounds-checked reader over a contiguous byte buffer
+ *
+ * Provides the subset of the std::istream interface used by the section
+ * readers (read, seekg, tellg), so that a file already in memory can be parsed
+ * without going through a streambuf. The buffer is not owned and must outlive
+ * the reader. Reading or seeking past the end throws std::out_of_range.
+ */
+class BinaryReader {
+    public:
+    BinaryReader(const char *data, std::size_t size) : buffer(data), bufferSize(size), position(0) {};
+    const char *data() const { return buffer; };
+    std::size_t size() const { return bufferSize; };
+    std::size_t remaining() const { return bufferSize - position; };
+    std::streamoff tellg() const { return position; };
+    void seekg(std::streamoff off, std::ios::seekdir dir = std::ios::beg) {
+        std::streamoff base = dir == std::ios::beg ? 0 : dir == std::ios::cur ? std::streamoff(position) : std::streamoff(bufferSize);
+        std::streamoff target = base + off;
+        if (target < 0 || target > std::streamoff(bufferSize)) {
+            throw std::out_of_range("BinaryReader: seek outside of buffer");
+        }
+        position = target;
+    };
+    void read(char *dst, std::size_t len) {
+        auto src = peek(len);
+        if (len > 0) {
+            std::memcpy(dst, src, len);
+        }
+        position += len;
+    };
+    /**
+     * @brief returns a pointer to the next len bytes without advancing the cursor
+     */
+    const char *peek(std::size_t len) const {
+        if (len > remaining()) {
+            throw std::out_of_range("BinaryReader: read past end of buffer");
+        }
+        return buffer + position;
+    };
+    private:
+    const char *buffer;
+    std::size_t bufferSize;
+    std::size_t position;
+};
+
+/**
+ * @brief append-only writer into a contiguous byte buffer
+ *
+ * Provides the write/put subset of the std::ostream interface used by the
+ * section writers. Writers emit strictly forward, so the buffer only grows;
+ * reserve the final size up front to write without reallocating.
+ */
+class BinaryWriter {
+    public:
+    BinaryWriter() = default;
+    explicit BinaryWriter(std::size_t capacity) { buffer.reserve(capacity); };
+    void reserve(std::size_t capacity) { buffer.reserve(capacity); };
+    const char *data() const { return buffer.data(); };
+    std::size_t size() const { return buffer.size(); };
+    std::streamoff tellp() const { return buffer.size(); };
+    void write(const char *src, std::size_t len) {
+        buffer.insert(buffer.end(), src, src + len);
+    };
+    void put(char c) {
+        buffer.push_back(c);
+    };
+    void fill(std::size_t count, char c = '\0') {
+        buffer.insert(buffer.end(), count, c);
+    };
+    /**
+     * @brief appends len uninitialized bytes and returns a pointer to them
+     */
+    char *grow(std::size_t len) {
+        buffer.resize(buffer.size() + len);
+        return buffer.data() + buffer.size() - len;
+    };
+    /**
+     * @brief moves the written bytes out of the writer, leaving it empty
+     */
+    std::vector<char> release() {
+        return std::move(buffer);
+    };
+    private:
+    std::vector<char> buffer;
+};
+
+/**
+ * @brief reads a fixed-length, zero-padded string without copying it
+ *
+ * The view points into the reader's buffer and is only valid as long as it.
+ */
+std::string_view readFixedStrView(BinaryReader &stream, int len);
+/**
+ * @brief reads a null terminated string without copying it
+ *
+ * The view points into the reader's buffer and is only valid as long as it.
+ */
+std::string_view readNullTerminatedStrView(BinaryReader &stream);
+std::string readFixedStr(BinaryReader &stream, int len);
+void writeFixedStr(std::string_view str, BinaryWriter &stream, int len);
+std::string readNullTerminatedStr(BinaryReader &stream);
+void writeNullTerminatedStr(const std::string &str, BinaryWriter &stream);
+/**
+ * @brief name stored inline in at most N bytes, as in a fixed-size name field
+ *
+ * The bytes past the name are kept zeroed, so comparing and hashing work on
+ * whole 64-bit words plus the length.
+ */
+template<std::size_t N>
+class FixedName {
+    public:
+    static constexpr std::size_t CAPACITY = N;
+    FixedName() = default;
+    explicit FixedName(std::string_view str) { assign(str); };
+    FixedName &operator=(std::string_view str) {
+        assign(str);
+        return *this;
+    };
+    /**
+     * @brief replaces the name, throwing std::length_error if it does not fit
+     */
+    void assign(std::string_view str) {
+        if (str.size() > N) {
+            throw std::length_error("name " + std::string(str) + " is longer than " + std::to_string(N) + " bytes");
+        }
+        words = {};
+        std::memcpy(words.data(), str.data(), str.size());
+        length = str.size();
+    };
+    const char *data() const { return reinterpret_cast<const char *>(words.data()); };
+    std::size_t size() const { return length; };
+    bool empty() const { return length == 0; };
+    std::string_view view() const { return std::string_view(data(), length); };
+    operator std::string_view() const { return view(); };
+    std::string str() const { return std::string(view()); };
+    std::size_t hash() const {
+        std::uint64_t h = length;
+        for (auto word: words) {
+            h = (h ^ word) * 0x9e3779b97f4a7c15;
+            h ^= h >> 32;
+        }
+        return h;
+    };
+    struct Hash {
+        std::size_t operator()(const FixedName &name) const { return name.hash(); };
+    };
+    // a name can end in NULs, so equal words alone do not mean equal names
+    friend bool operator==(const FixedName &a, const FixedName &b) { return a.length == b.length && a.words == b.words; };
+    friend bool operator!=(const FixedName &a, const FixedName &b) { return !(a == b); };
+    friend bool operator==(const FixedName &a, std::string_view b) { return a.view() == b; };
+    friend bool operator!=(const FixedName &a, std::string_view b) { return a.view() != b; };
+    friend bool operator==(std::string_view a, const FixedName &b) { return a == b.view(); };
+    friend bool operator!=(std::string_view a, const FixedName &b) { return a != b.view(); };
+    friend std::ostream &operator<<(std::ostream &stream, const FixedName &name) { return stream << name.view(); };
+    private:
+    std::array<std::uint64_t, (N + 7) / 8> words{};
+    std::uint8_t length = 0;
+};
+/**
+ * @brief reads a fixed-size name field of N bytes
+ */
+template<std::size_t N>
+FixedName<N> readFixedName(BinaryReader &stream) {
+    return FixedName<N>(readFixedStrView(stream, N));
+}
+/**
+ * @brief writes a fixed-size name field of N bytes, zero padded
+ */
+template<std::size_t N>
+void writeFixedName(const FixedName<N> &name, BinaryWriter &stream) {
+    stream.write(name.data(), N);
+}
+/**
+ * @brief byte order of serialized data
+ */
+enum class Endian {
+    Little, Big
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr Endian NATIVE_ENDIAN = Endian::Big;
+constexpr Endian FOREIGN_ENDIAN = Endian::Little;
+#else
+constexpr Endian NATIVE_ENDIAN = Endian::Little;
+constexpr Endian FOREIGN_ENDIAN = Endian::Big;
+#endif
+
+/**
+ * @brief reverses the byte order of an arithmetic value
+ */
+template<class T>
+inline T byteswap(T value) {
+    static_assert(std::is_trivially_copyable_v<T>, "byteswap needs a trivially copyable type");
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else {
+        using U = std::conditional_t<sizeof(T) == 2, std::uint16_t, std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>>;
+        static_assert(sizeof(T) == sizeof(U), "byteswap needs a 1, 2, 4 or 8 byte type");
+        U bits;
+        std::memcpy(&bits, &value, sizeof(T));
+#if defined(__GNUC__) || defined(__clang__)
+        if constexpr (sizeof(T) == 2) bits = __builtin_bswap16(bits);
+        else if constexpr (sizeof(T) == 4) bits = __builtin_bswap32(bits);
+        else bits = __builtin_bswap64(bits);
+#else
+        U swapped = 0;
+        for (std::size_t i=0; i<sizeof(U); ++i) {
+            swapped = (swapped << 8) | ((bits >> (8 * i)) & 0xff);
+        }
+        bits = swapped;
+#endif
+        std::memcpy(&value, &bits, sizeof(T));
+        return value;
+    }
+}
+
+/**
+ * @brief converts between byte order E and the host byte order
+ */
+template<Endian E, class T>
+inline T convertEndian(T value) {
+    if constexpr (E == NATIVE_ENDIAN) {
+        return value;
+    } else {
+        return byteswap(value);
+    }
+}
+
+/**
+ * @brief calls f with the byte order tag matching reverseEndian
+ *
+ * Use this to hoist the byte order check out of an inner loop: f receives a
+ * std::integral_constant<Endian, E>, so code templated on it compiles to
+ * straight-line conversions without a branch per element.
+ */
+template<class F>
+inline decltype(auto) withEndian(bool reverseEndian, F &&f) {
+    if (reverseEndian) {
+        return f(std::integral_constant<Endian, FOREIGN_ENDIAN>());
+    }
+    return f(std::integral_constant<Endian, NATIVE_ENDIAN>());
+}
+
+template<class T, Endian E>
+T readNumber(BinaryReader &stream) {
+    T res;
+    stream.read(reinterpret_cast<char *>(&res), sizeof(T));
+    return convertEndian<E>(res);
+}
+template<Endian E, class T>
+void writeNumber(T number, BinaryWriter &stream) {
+    number = convertEndian<E>(number);
+    stream.write(reinterpret_cast<const char *>(&number), sizeof(T));
+}
 template<class T>
-T readNumber(std::istream &stream, bool reverseEndian) {
+T readNumber(BinaryReader &stream, bool reverseEndian) {
     T res;
-    char *resPtr = reinterpret_cast<char *>(&res);
-    stream.read(resPtr, sizeof(T));
+    stream.read(reinterpret_cast<char *>(&res), sizeof(T));
+    return reverseEndian ? byteswap(res) : res;
+}
+template<class T>
+void writeNumber(T number, BinaryWriter &stream, bool reverseEndian) {
     if (reverseEndian) {
-        std::reverse(resPtr, resPtr + sizeof(T));
+        number = byteswap(number);
+    }
+    stream.write(reinterpret_cast<const char *>(&number), sizeof(T));
+}
+/**
+ * @brief reverses the byte order of count consecutive elements in place
+ *
+ * Uses AVX2 or SSE2 shuffles where available and falls back to scalar swaps.
+ * elementSize must be 1, 2, 4 or 8.
+ */
+void byteswapArray(char *data, std::size_t count, std::size_t elementSize);
+// below this many bytes, swapping in place beats the bulk copy and the call into byteswapArray
+constexpr std::size_t BYTESWAP_ARRAY_MIN_BYTES = 32;
+/**
+ * @brief reads count consecutive numbers into dst with one bulk copy
+ *
+ * Foreign-order arrays shorter than BYTESWAP_ARRAY_MIN_BYTES are swapped one
+ * number at a time instead.
+ */
+template<class T>
+void readArray(BinaryReader &stream, T *dst, std::size_t count, bool reverseEndian) {
+    static_assert(std::is_arithmetic_v<T>, "readArray needs an arithmetic type");
+    if (reverseEndian && count * sizeof(T) < BYTESWAP_ARRAY_MIN_BYTES) {
+        for (std::size_t i=0; i<count; ++i) {
+            dst[i] = readNumber<T>(stream, true);
+        }
+        return;
+    }
+    char *bytes = reinterpret_cast<char *>(dst);
+    stream.read(bytes, count * sizeof(T));
+    if (reverseEndian) {
+        byteswapArray(bytes, count, sizeof(T));
     }
-    return res;
 }
+/**
+ * @brief writes count consecutive numbers from src with one bulk copy
+ */
 template<class T>
-void writeNumber(T number, std::ostream &stream, bool reverseEndian) {
-    char *numPtr = reinterpret_cast<char *>(&number);
+void writeArray(const T *src, std::size_t count, BinaryWriter &stream, bool reverseEndian) {
+    static_assert(std::is_arithmetic_v<T>, "writeArray needs an arithmetic type");
+    if (count == 0) {
+        return;
+    }
+    char *bytes = stream.grow(count * sizeof(T));
+    if (reverseEndian && count * sizeof(T) < BYTESWAP_ARRAY_MIN_BYTES) {
+        for (std::size_t i=0; i<count; ++i) {
+            T value = byteswap(src[i]);
+            std::memcpy(bytes + i * sizeof(T), &value, sizeof(T));
+        }
+        return;
+    }
+    std::memcpy(bytes, src, count * sizeof(T));
     if (reverseEndian) {
-        std::reverse(numPtr, numPtr + sizeof(T));
+        byteswapArray(bytes, count, sizeof(T));
+    }
+}
+template<Endian E, class T>
+void readArray(BinaryReader &stream, T *dst, std::size_t count) {
+    readArray(stream, dst, count, E != NATIVE_ENDIAN);
+}
+template<Endian E, class T>
+void writeArray(const T *src, std::size_t count, BinaryWriter &stream) {
+    writeArray(src, count, stream, E != NATIVE_ENDIAN);
+}
+template<Endian E>
+std::u16string readNullTerminatedStrU16(BinaryReader &stream);
+template<Endian E>
+void writeNullTerminatedStrU16(const std::u16string &str, BinaryWriter &stream);
+// single bytes read the same in either byte order; E only keeps the call sites uniform
+template<Endian E>
+color8 readColor8(BinaryReader &stream) {
+    color8 res;
+    stream.read(reinterpret_cast<char *>(res.data()), res.size());
+    return res;
+}
+template<Endian E>
+void writeColor8(const color8 &color, BinaryWriter &stream) {
+    stream.write(reinterpret_cast<const char *>(color.data()), color.size());
+}
+template<Endian E>
+color16 readColor16(BinaryReader &stream) {
+    color16 res;
+    for (auto &colval: res) {
+        colval = readNumber<std::uint16_t, E>(stream);
+    }
+    return res;
+}
+template<Endian E>
+void writeColor16(const color16 &color, BinaryWriter &stream) {
+    for (auto colval: color) {
+        writeNumber<E>(colval, stream);
     }
-    stream.write(numPtr, sizeof(T));
 }
-color8 readColor8(std::istream &stream, bool reverseEndian);
-void writeColor8(const color8 &color, std::ostream &stream, bool reverseEndian);
-color16 readColor16(std::istream &stream, bool reverseEndian);
-void writeColor16(const color16 &color, std::ostream &stream, bool reverseEndian);
 color8 toColor8(const color16 &color);
 color16 toColor16(const color8 &color);
 
+/**
+ * @brief vector that keeps up to N elements inline and only uses the heap beyond that
+ *
+ * For arrays that are short in the common case, so typical files decode without allocating.
+ */
+template<class T, std::size_t N>
+class SmallVector {
+    public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T *;
+    using const_iterator = const T *;
+    SmallVector() = default;
+    SmallVector(std::size_t count, const T &value) { resize(count, value); };
+    SmallVector(std::initializer_list<T> values) {
+        reserve(values.size());
+        std::uninitialized_copy(values.begin(), values.end(), first);
+        count = values.size();
+    };
+    SmallVector(const SmallVector &other) {
+        reserve(other.count);
+        std::uninitialized_copy(other.begin(), other.end(), first);
+        count = other.count;
+    };
+    SmallVector(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>) { moveFrom(other); };
+    SmallVector &operator=(const SmallVector &other) {
+        if (this != &other) {
+            clear();
+            reserve(other.count);
+            std::uninitialized_copy(other.begin(), other.end(), first);
+            count = other.count;
+        }
+        return *this;
+    };
+    SmallVector &operator=(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            clear();
+            release();
+            moveFrom(other);
+        }
+        return *this;
+    };
+    ~SmallVector() {
+        clear();
+        release();
+    };
+    T *data() { return first; };
+    const T *data() const { return first; };
+    std::size_t size() const { return count; };
+    std::size_t capacity() const { return cap; };
+    bool empty() const { return count == 0; };
+    T *begin() { return first; };
+    T *end() { return first + count; };
+    const T *begin() const { return first; };
+    const T *end() const { return first + count; };
+    T &operator[](std::size_t i) { return first[i]; };
+    const T &operator[](std::size_t i) const { return first[i]; };
+    T &front() { return first[0]; };
+    const T &front() const { return first[0]; };
+    T &back() { return first[count - 1]; };
+    const T &back() const { return first[count - 1]; };
+    void reserve(std::size_t newCapacity) {
+        if (newCapacity <= cap) {
+            return;
+        }
+        T *newData = std::allocator<T>().allocate(newCapacity);
+        std::uninitialized_move(first, first + count, newData);
+        std::destroy(first, first + count);
+        release();
+        first = newData;
+        cap = newCapacity;
+    };
+    void resize(std::size_t newSize) {
+        if (newSize < count) {
+            std::destroy(first + newSize, first + count);
+        } else {
+            reserve(newSize);
+            std::uninitialized_value_construct(first + count, first + newSize);
+        }
+        count = newSize;
+    };
+    void resize(std::size_t newSize, const T &value) {
+        if (newSize < count) {
+            std::destroy(first + newSize, first + count);
+        } else {
+            T copy(value);
+            reserve(newSize);
+            std::uninitialized_fill(first + count, first + newSize, copy);
+        }
+        count = newSize;
+    };
+    template<class... Args>
+    T &emplace_back(Args &&...args) {
+        if (count == cap) {
+            // args may refer to an element, so build the new one before moving the old ones
+            T value(std::forward<Args>(args)...);
+            reserve(cap ? cap * 2 : 1);
+            new (first + count) T(std::move(value));
+        } else {
+            new (first + count) T(std::forward<Args>(args)...);
+        }
+        return first[count++];
+    };
+    void push_back(const T &value) { emplace_back(value); };
+    void push_back(T &&value) { emplace_back(std::move(value)); };
+    void pop_back() { std::destroy_at(first + --count); };
+    T *insert(const T *pos, const T &value) { return insertAt(pos - first, T(value)); };
+    T *insert(const T *pos, T &&value) { return insertAt(pos - first, std::move(value)); };
+    T *erase(const T *pos) { return erase(pos, pos + 1); };
+    T *erase(const T *rangeFirst, const T *rangeLast) {
+        T *dst = first + (rangeFirst - first);
+        T *src = first + (rangeLast - first);
+        T *newEnd = std::move(src, end(), dst);
+        std::destroy(newEnd, end());
+        count = newEnd - first;
+        return dst;
+    };
+    friend bool operator==(const SmallVector &a, const SmallVector &b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    };
+    friend bool operator!=(const SmallVector &a, const SmallVector &b) { return !(a == b); };
+    void clear() {
+        std::destroy(first, first + count);
+        count = 0;
+    };
+    private:
+    alignas(T) unsigned char storage[N * sizeof(T)];
+    T *first = inlineData();
+    std::size_t count = 0;
+    std::size_t cap = N;
+    T *inlineData() { return reinterpret_cast<T *>(storage); };
+    T *insertAt(std::size_t index, T &&value) {
+        emplace_back(std::move(value));
+        std::rotate(first + index, first + count - 1, first + count);
+        return first + index;
+    };
+    void release() {
+        if (first != inlineData()) {
+            std::allocator<T>().deallocate(first, cap);
+            first = inlineData();
+            cap = N;
+        }
+    };
+    void moveFrom(SmallVector &other) {
+        if (other.first == other.inlineData()) {
+            std::uninitialized_move(other.begin(), other.end(), first);
+            count = other.count;
+            other.clear();
+        } else {
+            first = other.first;
+            cap = other.cap;
+            count = other.count;
+            other.first = other.inlineData();
+            other.cap = N;
+            other.count = 0;
+        }
+    };
+};
+
 /**
  * @brief 2d vector class
  * 
@@ -56,13 +552,15 @@ color16 toColor16(const color8 &color);
 template<class T>
 struct vec2 {
     T x,y;
-    void read(std::istream &stream, bool revEndian) {
-        x = readNumber<T>(stream, revEndian);
-        y = readNumber<T>(stream, revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream) {
+        x = readNumber<T, E>(stream);
+        y = readNumber<T, E>(stream);
     }
-    void write(std::ostream &stream, bool revEndian) const {
-        writeNumber(x, stream, revEndian);
-        writeNumber(y, stream, revEndian);
+    template<Endian E>
+    void write(BinaryWriter &stream) const {
+        writeNumber<E>(x, stream);
+        writeNumber<E>(y, stream);
     }
 };
 
@@ -74,15 +572,17 @@ struct vec2 {
 template<class T>
 struct vec3 {
     T x,y,z;
-    void read(std::istream &stream, bool revEndian) {
-        x = readNumber<T>(stream, revEndian);
-        y = readNumber<T>(stream, revEndian);
-        z = readNumber<T>(stream, revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream) {
+        x = readNumber<T, E>(stream);
+        y = readNumber<T, E>(stream);
+        z = readNumber<T, E>(stream);
     }
-    void write(std::ostream &stream, bool revEndian) const {
-        writeNumber(x, stream, revEndian);
-        writeNumber(y, stream, revEndian);
-        writeNumber(z, stream, revEndian);
+    template<Endian E>
+    void write(BinaryWriter &stream) const {
+        writeNumber<E>(x, stream);
+        writeNumber<E>(y, stream);
+        writeNumber<E>(z, stream);
     }
 };
 
@@ -107,8 +607,24 @@ struct TexCoord {
     vec2<float> topRight;
     vec2<float> bottomLeft;
     vec2<float> bottomRight;
+    template<Endian E>
+    void read(BinaryReader &stream) {
+        topLeft.read<E>(stream);
+        topRight.read<E>(stream);
+        bottomLeft.read<E>(stream);
+        bottomRight.read<E>(stream);
+    }
+    template<Endian E>
+    void write(BinaryWriter &stream) const {
+        topLeft.write<E>(stream);
+        topRight.write<E>(stream);
+        bottomLeft.write<E>(stream);
+        bottomRight.write<E>(stream);
+    }
 };
 
+static_assert(sizeof(TexCoord) == 8 * sizeof(float), "TexCoord must be 8 packed floats for bulk reads");
+
 enum class LineAlign : std::uint8_t {
     Unspecified = 0,
     Left = 1,
@@ -122,14 +638,14 @@ enum class WindowKind {
     HorizontalNoContent = 2
 };
 
-template<class Material>
+template<class MaterialPtr>
 struct BaseWindowContent {
     color8 colorTopLeft;
     color8 colorTopRight;
     color8 colorBottomLeft;
     color8 colorBottomRight;
-    std::shared_ptr<Material> material;
-    std::vector<TexCoord> texCoords;
+    MaterialPtr material;
+    SmallVector<TexCoord, 1> texCoords;
 };
 
 enum WindowFrameTexFlip : std::uint8_t {
@@ -141,12 +657,86 @@ enum WindowFrameTexFlip : std::uint8_t {
     Rotate270 = 5
 };
 
-template<class Material>
+template<class MaterialPtr>
 struct BaseWindowFrame {
-    std::shared_ptr<Material> material;
+    MaterialPtr material;
     WindowFrameTexFlip texFlip;
 };
 
+/**
+ * @brief calls f(i) for every i in [0, count) on up to threads threads
+ *
+ * Threads take small blocks of indices from a shared counter, so uneven items
+ * balance out. 0 threads uses every core, and short ranges run on the calling
+ * thread only. The first exception thrown by f is rethrown to the caller.
+ */
+void parallelFor(std::size_t count, unsigned threads, const std::function<void(std::size_t)> &f);
+
+/**
+ * @brief monotonic allocator that owns the nodes of one document
+ *
+ * Memory is handed out from a list of growing chunks and is only returned
+ * when the arena itself is destroyed, so tearing down a whole layout costs one
+ * free per chunk instead of one per node. Not thread-safe.
+ */
+class Arena {
+    public:
+    explicit Arena(std::size_t initialChunkSize = 0x1000);
+    ~Arena();
+    Arena(const Arena &other) = delete;
+    Arena &operator=(const Arena &other) = delete;
+    void *allocate(std::size_t size, std::size_t alignment);
+    /**
+     * @brief total size of the chunks held by the arena
+     */
+    std::size_t capacity() const { return chunkBytes; };
+    private:
+    struct Chunk {
+        Chunk *next;
+    };
+    Chunk *chunks = nullptr;
+    char *cursor = nullptr;
+    char *chunkEnd = nullptr;
+    std::size_t nextChunkSize;
+    std::size_t chunkBytes = 0;
+};
+
+/**
+ * @brief standard allocator over an Arena for use with std::allocate_shared
+ *
+ * The allocator does not own the arena: the document that created a node owns
+ * it, so nodes and their shared_ptrs are only valid while that document lives.
+ */
+template<class T>
+struct ArenaAllocator {
+    using value_type = T;
+    Arena *arena;
+    explicit ArenaAllocator(Arena *a) : arena(a) {};
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {};
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    };
+    void deallocate(T *, std::size_t) {
+        // released together with the arena
+    };
+    template<class U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; };
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; };
+};
+
+/**
+ * @brief creates a node in the arena, or on the heap if there is no arena
+ */
+template<class T, class... Args>
+std::shared_ptr<T> makeShared(const std::shared_ptr<Arena> &arena, Args&&... args) {
+    if (arena) {
+        return std::allocate_shared<T>(ArenaAllocator<T>(arena.get()), std::forward<Args>(args)...);
+    }
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
 struct BaseHeader;
 
 /**
@@ -154,19 +744,45 @@ struct BaseHeader;
  * 
  */
 struct Section {
-    virtual void read(std::istream &stream, const BaseHeader &header);
-    virtual void write(std::ostream &stream, const BaseHeader &header);
+    /**
+     * @brief reads the content in byte order E; sections with content hide this
+     *
+     * Not virtual, so the documents dispatch on the byte order once and on the
+     * section type themselves, and the reads inline into straight-line code.
+     */
+    template<Endian E>
+    void read(BinaryReader &, const BaseHeader &) {};
+    template<Endian E>
+    void write(BinaryWriter &, const BaseHeader &) {};
+    /**
+     * @brief number of bytes write() emits, excluding the section header
+     *
+     * Writers use this to lay out offsets and sizes before emitting anything,
+     * so that the output is written strictly forward.
+     */
+    virtual std::uint32_t size(const BaseHeader &header);
     virtual ~Section();
 };
 
+/**
+ * @brief concrete type of a pane
+ */
+enum class PaneKind : std::uint8_t {
+    Pane, Picture, Text, Bounding, Window
+};
+
 /**
  * @brief base class for layout panes
  * 
  */
 struct BasePane : Section {
-    std::string name;
+    /**
+     * @brief set by the concrete type, so code can dispatch on it without RTTI
+     */
+    PaneKind kind;
+    FixedName<0x10> name;
     std::uint8_t paneMagFlags;
-    std::string userDataInfo;
+    FixedName<0x8> userDataInfo;
     bool visible;
     vec3<float> translate;
     vec3<float> rotate;
@@ -181,16 +797,306 @@ struct BasePane : Section {
     bool influenceAlpha;
     std::weak_ptr<BasePane> parent;
     std::vector<std::shared_ptr<BasePane>> children;
-    virtual std::string signature() = 0;
+    virtual std::string_view signature() = 0;
+    protected:
+    // only the concrete pane types pick their kind, so visitPane can trust it
+    explicit BasePane(PaneKind kind) : kind(kind) {};
 };
 
+/**
+ * @brief packs a four character section magic into an integer
+ *
+ * The first character ends up in the most significant byte, so the value
+ * matches the magic read as a big-endian number.
+ */
+constexpr std::uint32_t fourcc(std::string_view magic) {
+    std::uint32_t result = 0;
+    for (std::size_t i=0; i<4; ++i) {
+        result = (result << 8) | (i < magic.size() ? std::uint8_t(magic[i]) : 0);
+    }
+    return result;
+}
+
+// sections without content that open and close a level of the pane or group tree
+constexpr std::string_view PANE_START_MAGIC = "pas1";
+constexpr std::string_view PANE_END_MAGIC = "pae1";
+constexpr std::string_view GROUP_START_MAGIC = "grs1";
+constexpr std::string_view GROUP_END_MAGIC = "gre1";
+
 struct GroupPane : Section {
-    static inline const std::string MAGIC = "grp1";
-    std::string name;
-    std::vector<std::string> panes;
+    static constexpr std::string_view MAGIC = "grp1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
+    FixedName<0x10> name;
+    std::vector<FixedName<0x10>> panes;
     std::vector<std::shared_ptr<GroupPane>> children;
     std::weak_ptr<GroupPane> parent;
-    std::string signature();
+    std::string_view signature();
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
+};
+
+/**
+ * @brief pane or group hierarchy stored as one contiguous array in pre-order
+ *
+ * Every node records its parent, first child and next sibling as indices
+ * into the array, so traversals walk memory linearly instead of chasing
+ * children pointers. The tree keeps the panes alive, and toTree() writes the
+ * flat topology back into the panes' children and parent links.
+ */
+template<class P>
+class FlatTree {
+    public:
+    static constexpr std::uint32_t NONE = 0xffffffff;
+    struct Node {
+        P *pane;
+        std::uint32_t type; // fourcc of the pane signature
+        std::uint32_t parent;
+        std::uint32_t firstChild;
+        std::uint32_t nextSibling;
+        std::uint32_t subtreeEnd; // one past the last descendant
+    };
+    FlatTree() = default;
+    explicit FlatTree(const std::shared_ptr<P> &root) {
+        if (!root) {
+            return;
+        }
+        // iterative pre-order walk; each stack entry is a node index, its next child position and its last added child
+        struct Frame {
+            std::uint32_t index;
+            std::size_t nextChild;
+            std::uint32_t lastChild;
+        };
+        std::vector<Frame> stack;
+        auto addNode = [&](const std::shared_ptr<P> &pane, std::uint32_t parent) {
+            std::uint32_t index = nodeList.size();
+            nodeList.push_back({pane.get(), fourcc(pane->signature()), parent, NONE, NONE, NONE});
+            panes.push_back(pane);
+            stack.push_back({index, 0, NONE});
+        };
+        addNode(root, NONE);
+        while (!stack.empty()) {
+            auto &top = stack.back();
+            auto index = top.index;
+            auto &children = panes[index]->children;
+            if (top.nextChild == children.size()) {
+                nodeList[index].subtreeEnd = nodeList.size();
+                stack.pop_back();
+                continue;
+            }
+            auto &child = children[top.nextChild++];
+            std::uint32_t childIndex = nodeList.size();
+            if (top.lastChild == NONE) {
+                nodeList[index].firstChild = childIndex;
+            } else {
+                nodeList[top.lastChild].nextSibling = childIndex;
+            }
+            top.lastChild = childIndex;
+            addNode(child, index);
+        }
+    };
+    /**
+     * @brief relinks the panes as described by the flat array and returns the root
+     */
+    std::shared_ptr<P> toTree() const {
+        for (auto &pane: panes) {
+            pane->children.clear();
+        }
+        for (std::size_t i=0; i<nodeList.size(); ++i) {
+            auto parent = nodeList[i].parent;
+            if (parent == NONE) {
+                panes[i]->parent.reset();
+            } else {
+                panes[parent]->children.push_back(panes[i]);
+                panes[i]->parent = panes[parent];
+            }
+        }
+        return panes.empty() ? nullptr : panes.front();
+    };
+    std::size_t size() const { return nodeList.size(); };
+    bool empty() const { return nodeList.empty(); };
+    const Node &operator[](std::size_t i) const { return nodeList[i]; };
+    const std::vector<Node> &nodes() const { return nodeList; };
+    std::shared_ptr<P> pane(std::size_t i) const { return panes[i]; };
+    /**
+     * @brief calls f(index, node) for every pane in depth-first pre-order
+     *
+     * If f returns false, the descendants of that pane are skipped.
+     */
+    template<class F>
+    void forEachDepthFirst(F &&f) const {
+        for (std::uint32_t i=0; i<nodeList.size();) {
+            if (f(i, nodeList[i])) {
+                ++i;
+            } else {
+                i = nodeList[i].subtreeEnd;
+            }
+        }
+    }
+    /**
+     * @brief calls f(index, node) for every pane in breadth-first order
+     */
+    template<class F>
+    void forEachBreadthFirst(F &&f) const {
+        if (nodeList.empty()) {
+            return;
+        }
+        std::vector<std::uint32_t> queue;
+        queue.reserve(nodeList.size());
+        queue.push_back(0);
+        for (std::size_t head=0; head<queue.size(); ++head) {
+            auto i = queue[head];
+            f(i, nodeList[i]);
+            for (auto c = nodeList[i].firstChild; c != NONE; c = nodeList[c].nextSibling) {
+                queue.push_back(c);
+            }
+        }
+    }
+    private:
+    std::vector<Node> nodeList;
+    std::vector<std::shared_ptr<P>> panes;
+};
+
+using FlatPaneTree = FlatTree<BasePane>;
+using FlatGroupTree = FlatTree<GroupPane>;
+
+/**
+ * @brief location of one section, as listed by BaseHeader::scanSections
+ */
+struct SectionEntry {
+    std::uint32_t magic; // fourcc of the section magic
+    std::uint32_t offset; // from the start of the file
+    std::uint32_t size;
+    std::uint32_t depth; // nesting level inside pas1/pae1 and grs1/gre1 blocks
+};
+
+/**
+ * @brief returns the nth section with the given magic or nullptr
+ *
+ * nth counts only sections of that magic, starting at 0: nth = 2 with the
+ * pic1 magic is the third pic1, whatever panes of other types come before it.
+ */
+const SectionEntry *findSection(const std::vector<SectionEntry> &directory, std::uint32_t magic, std::size_t nth = 0);
+
+/**
+ * @brief options that control how a file is parsed
+ */
+struct ReadOptions {
+    /**
+     * @brief keep material bodies encoded until they are first dereferenced
+     *
+     * Untouched materials are written back verbatim. Decode them before
+     * changing the byte order or the texture list.
+     */
+    bool lazyMaterials = false;
+    /**
+     * @brief threads used to decode independent records such as materials and animation entries, 0 uses every core
+     */
+    unsigned threads = 1;
+};
+
+/**
+ * @brief cost of reading or writing one section, as reported to a SectionObserver
+ */
+struct SectionStats {
+    std::uint32_t magic; // fourcc of the section magic
+    bool write;
+    std::uint32_t size; // including the section header
+    std::uint64_t nanoseconds;
+    std::uint64_t allocations;
+};
+
+/**
+ * @brief receives the cost of every section a document reads or writes
+ *
+ * Only called when the library is built with BECQUEREL_INSTRUMENT, otherwise
+ * the hooks compile to nothing.
+ */
+class SectionObserver {
+    public:
+    virtual ~SectionObserver();
+    virtual void onSection(const SectionStats &stats) = 0;
+    /**
+     * @brief current value of a process-wide allocation counter, 0 if there is none
+     *
+     * The library does not replace operator new, so the count has to come
+     * from the application.
+     */
+    virtual std::uint64_t allocationCount() const { return 0; };
+};
+
+/**
+ * @brief observer that aggregates sections by type, with a histogram of their times
+ *
+ * Safe to share between documents read on different threads.
+ */
+class SectionHistogram : public SectionObserver {
+    public:
+    /**
+     * @param allocationCounter returns the application's allocation counter, or is empty
+     */
+    explicit SectionHistogram(std::function<std::uint64_t()> allocationCounter = nullptr)
+        : allocationCounter(std::move(allocationCounter)) {};
+    void onSection(const SectionStats &stats) override;
+    std::uint64_t allocationCount() const override { return allocationCounter ? allocationCounter() : 0; };
+    /**
+     * @brief prints a line per section type and direction, most total time first
+     *
+     * The allocations column is only printed when an allocation counter was given.
+     */
+    void print(std::ostream &stream) const;
+    private:
+    // upper bounds of the time buckets in nanoseconds, the last bucket has none
+    static constexpr std::array<std::uint64_t, 5> BUCKET_LIMITS = {1000, 10000, 100000, 1000000, 10000000};
+    struct Entry {
+        std::uint64_t count = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t maxNanoseconds = 0;
+        std::uint64_t allocations = 0;
+        std::array<std::uint64_t, BUCKET_LIMITS.size() + 1> buckets{};
+    };
+    std::function<std::uint64_t()> allocationCounter;
+    mutable std::mutex mutex;
+    std::map<std::pair<std::uint32_t, bool>, Entry> entries;
+};
+
+/**
+ * @brief reports the time and allocations from its construction to its destruction
+ *
+ * Empty unless BECQUEREL_INSTRUMENT is defined, so the hooks cost nothing
+ * in a regular build.
+ */
+class SectionTimer {
+    public:
+#ifdef BECQUEREL_INSTRUMENT
+    SectionTimer(SectionObserver *observer, std::uint32_t magic, bool write, std::uint32_t size)
+        : observer(observer), stats{magic, write, size, 0, 0} {
+        if (observer) {
+            stats.allocations = observer->allocationCount();
+            start = std::chrono::steady_clock::now();
+        }
+    };
+    ~SectionTimer() {
+        if (observer) {
+            stats.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            stats.allocations = observer->allocationCount() - stats.allocations;
+            observer->onSection(stats);
+        }
+    };
+#else
+    SectionTimer(SectionObserver *, std::uint32_t, bool, std::uint32_t) {};
+#endif
+    SectionTimer(const SectionTimer &other) = delete;
+    SectionTimer &operator=(const SectionTimer &other) = delete;
+#ifdef BECQUEREL_INSTRUMENT
+    private:
+    SectionObserver *observer;
+    SectionStats stats;
+    std::chrono::steady_clock::time_point start;
+#endif
 };
 
 /**
@@ -198,12 +1104,38 @@ struct GroupPane : Section {
  * 
  */
 struct BaseHeader {
+    /**
+     * @brief arena that nodes created while reading are allocated from
+     *
+     * Declared first so it is destroyed after every node that lives in it.
+     */
+    std::shared_ptr<Arena> arena;
     unsigned version;
     std::uint16_t bom;
     std::uint16_t headerSize;
     std::shared_ptr<BasePane> rootPane;
     std::shared_ptr<GroupPane> rootGroup;
+    ReadOptions readOptions;
+    /**
+     * @brief receives the cost of each section read or written, see SectionObserver
+     */
+    SectionObserver *observer = nullptr;
+    BaseHeader() = default;
+    // a copy would share the nodes and their arena, which is not thread-safe, so documents are only moved
+    BaseHeader(const BaseHeader &other) = delete;
+    BaseHeader &operator=(const BaseHeader &other) = delete;
+    BaseHeader(BaseHeader &&other) = default;
+    // assigning would free the old arena before the old nodes in it
+    BaseHeader &operator=(BaseHeader &&other) = delete;
     bool revEndian() const;
+    /**
+     * @brief reads the file header and returns the number of sections
+     */
+    std::uint16_t readFileHeader(BinaryReader &stream, std::string_view magic);
+    /**
+     * @brief reads the file header and lists the sections without decoding them
+     */
+    std::vector<SectionEntry> scanSections(BinaryReader &stream, std::string_view magic);
 };
 
 struct LayoutInfo : virtual Section {
@@ -215,20 +1147,28 @@ struct LayoutInfo : virtual Section {
 
 template<bool padding>
 struct Txl1 : Section {
-    static inline const std::string MAGIC = "txl1";
+    static constexpr std::string_view MAGIC = "txl1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     std::vector<std::string> textures;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 template struct Txl1<true>;
 
 template<bool padding>
 struct Fnl1 : Section {
-    static inline const std::string MAGIC = "fnl1";
+    static constexpr std::string_view MAGIC = "fnl1";
+    static constexpr std::uint32_t FOURCC = fourcc(MAGIC);
     std::vector<std::string> fonts;
-    void read(std::istream &stream, const BaseHeader &header);
-    void write(std::ostream &stream, const BaseHeader &header);
+    template<Endian E>
+    void read(BinaryReader &stream, const BaseHeader &header);
+    template<Endian E>
+    void write(BinaryWriter &stream, const BaseHeader &header);
+    std::uint32_t size(const BaseHeader &header);
 };
 
 template struct Fnl1<true>;
@@ -237,8 +1177,18 @@ struct TextureTransform {
     vec2<float> translate;
     float rotate;
     vec2<float> scale;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream) {
+        translate.read<E>(stream);
+        rotate = readNumber<float, E>(stream);
+        scale.read<E>(stream);
+    }
+    template<Endian E>
+    void write(BinaryWriter &stream) const {
+        translate.write<E>(stream);
+        writeNumber<E>(rotate, stream);
+        scale.write<E>(stream);
+    }
 };
 
 struct BlendMode {
@@ -269,8 +1219,20 @@ struct BlendMode {
     BlendFactor destFactor;
     Op logicOp;
 
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream) {
+        blendOp = (Op)readNumber<std::uint8_t, E>(stream);
+        srcFactor = (BlendFactor)readNumber<std::uint8_t, E>(stream);
+        destFactor = (BlendFactor)readNumber<std::uint8_t, E>(stream);
+        logicOp = (Op)readNumber<std::uint8_t, E>(stream);
+    }
+    template<Endian E>
+    void write(BinaryWriter &stream) const {
+        writeNumber<E>((std::uint8_t)blendOp, stream);
+        writeNumber<E>((std::uint8_t)srcFactor, stream);
+        writeNumber<E>((std::uint8_t)destFactor, stream);
+        writeNumber<E>((std::uint8_t)logicOp, stream);
+    }
 };
 
 enum class AlphaFunction : std::uint8_t {
@@ -361,25 +1323,33 @@ struct ProjectionTexGenParam {
     std::uint8_t flags;
 };
 
+// the hardware limits, stored inline so decoding a material never allocates
+constexpr std::size_t MAX_TEXTURE_MAPS = 8;
+constexpr std::size_t MAX_TEXTURE_MATRICES = 10;
+constexpr std::size_t MAX_TEX_COORD_GENS = 8;
+constexpr std::size_t MAX_TEV_STAGES = 16;
+constexpr std::size_t MAX_INDIRECT_TRANSFORMS = 3;
+constexpr std::size_t MAX_INDIRECT_STAGES = 4;
+
 template<class TexRefType, class TevStageType, class AlphaCompareType>
 struct BaseMaterial {
-    std::vector<TextureTransform> texTransforms;
-    std::string name;
+    SmallVector<TextureTransform, MAX_TEXTURE_MATRICES> texTransforms;
+    FixedName<0x14> name;
     color8 whiteColor;
     color8 blackColor;
     BlendMode blendMode;
     BlendMode blendModeLogic;
     AlphaCompareType alphaCompare;
     bool alphaInterp;
-    std::vector<TexRefType> textureMaps;
-    std::vector<TevStageType> tevStages;
-    std::vector<TexCoordGen> texCoordGens;
-    std::vector<ProjectionTexGenParam> projTexGenParams;
+    SmallVector<TexRefType, MAX_TEXTURE_MAPS> textureMaps;
+    SmallVector<TevStageType, MAX_TEV_STAGES> tevStages;
+    SmallVector<TexCoordGen, MAX_TEX_COORD_GENS> texCoordGens;
+    SmallVector<ProjectionTexGenParam, MAX_TEX_COORD_GENS> projTexGenParams;
 };
 
 struct BasePat1 : Section {
     std::string name;
-    std::vector<std::string> groups;
+    std::vector<FixedName<0x14>> groups;
     std::int16_t startFrame;
     std::int16_t endFrame;
     std::uint16_t animationOrder;
@@ -394,17 +1364,45 @@ struct KeyFrame {
     float frame;
     float value;
     float slope;
-    void read(std::istream &stream, bool revEndian, CurveType curveType);
-    void write(std::ostream &stream, bool revEndian, CurveType curveType);
+    template<Endian E>
+    void read(BinaryReader &stream, CurveType curveType) {
+        if (curveType == CurveType::Hermite) {
+            frame = readNumber<float, E>(stream);
+            value = readNumber<float, E>(stream);
+            slope = readNumber<float, E>(stream);
+        } else {
+            frame = readNumber<float, E>(stream);
+            value = readNumber<std::uint16_t, E>(stream);
+            stream.seekg(2, std::ios::cur);
+        }
+    }
+    template<Endian E>
+    void write(BinaryWriter &stream, CurveType curveType) const {
+        if (curveType == CurveType::Hermite) {
+            writeNumber<E>(frame, stream);
+            writeNumber<E>(value, stream);
+            writeNumber<E>(slope, stream);
+        } else {
+            writeNumber<E>(frame, stream);
+            writeNumber<E>((std::uint16_t)value, stream);
+            stream.put('\0');
+            stream.put('\0');
+        }
+    }
 };
 
+static_assert(sizeof(KeyFrame) == 3 * sizeof(float), "KeyFrame must be 3 packed floats for bulk reads");
+
 struct PaiTagEntry {
     std::uint8_t index;
     std::uint8_t target;
     CurveType curveType;
     std::vector<KeyFrame> keyFrames;
-    void read(std::istream &stream, bool revEndian);
-    void write(std::ostream &stream, bool revEndian);
+    template<Endian E>
+    void read(BinaryReader &stream);
+    template<Endian E>
+    void write(BinaryWriter &stream);
+    std::uint32_t size() const;
 };
 
 struct BasePaiTag {
@@ -418,7 +1416,7 @@ enum AnimationTarget : std::uint8_t {
 
 template<class TagType>
 struct BasePaiEntry {
-    std::string name;
+    FixedName<0x14> name;
     AnimationTarget target;
     std::vector<TagType> tags;
 };
@@ -461,29 +1459,75 @@ class TemporarySeekO {
     IO &stream;
     std::streampos oldSeekPos;
 };
-template<class T>
-class BitField {
-    T &theValue;
-    int internalBitStart;
-    int theNumBits;
+/**
+ * @brief numBits bits of an integer starting bitStart bits below its most significant bit
+ *
+ * Stateless, so fields packed into one integer cost no storage of their own.
+ */
+template<class T, int bitStart, int numBits>
+struct BitRange {
+    static constexpr int SHIFT = 8 * sizeof(T) - (bitStart + numBits);
+    static constexpr T MASK = ((T(1) << numBits) - 1) << SHIFT;
+    static constexpr T get(T value) { return (value & MASK) >> SHIFT; };
+    static constexpr T set(T value, T bits) { return (value & ~MASK) | ((bits << SHIFT) & MASK); };
+};
+
+/**
+ * @brief read-only memory mapping of a whole file
+ *
+ * The mapping is released when the object is destroyed, so anything parsed
+ * from it must be copied out before then. Throws std::system_error if the file
+ * cannot be opened or mapped.
+ */
+class MappedFile {
     public:
-    BitField(T &value, int bitStart, int numBits)
-        : theValue(value), internalBitStart(8 * sizeof(T) - (bitStart + numBits)), theNumBits(numBits) {};
-    operator T() const {
-        return (theValue >> internalBitStart) & ((T(1) << theNumBits) - 1);
-    };
-    BitField<T> &operator=(T newBits) {
-        T mask = ((T(1) << theNumBits) - 1) << internalBitStart;
-        theValue &= ~mask;
-        theValue |= (newBits << internalBitStart);
-        return *this;
-    };
-    BitField<T> &operator=(const BitField<T> &other) = delete;
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+    const char *data() const { return mapping; };
+    std::size_t size() const { return mappingSize; };
+    private:
+    const char *mapping = nullptr;
+    std::size_t mappingSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
 };
 
-void writeSection(const std::string &magic, Section &sec, std::ostream &stream, const BaseHeader &header);
+/**
+ * @brief reads everything from the current position of the stream to its end
+ */
+std::vector<char> readAll(std::istream &stream);
+
+/**
+ * @brief rounds size up to the 4 byte alignment of sections
+ */
+constexpr std::uint32_t align4(std::uint32_t size) {
+    return (size + 3) & ~std::uint32_t(3);
+}
+
+/**
+ * @brief size of a section including its header and trailing alignment
+ */
+std::uint32_t sectionSize(Section &sec, const BaseHeader &header);
+
+void writePadding(BinaryWriter &stream, std::size_t count);
 
-void alignFile(std::ostream &stream);
+/**
+ * @brief writes the section header, the content of sec in byte order E and the alignment
+ */
+template<Endian E, class S>
+void writeSection(std::string_view magic, S &sec, BinaryWriter &stream, const BaseHeader &header) {
+    auto contentSize = 8 + sec.size(header);
+    auto totalSize = align4(contentSize);
+    SectionTimer timer(header.observer, fourcc(magic), true, totalSize);
+    writeFixedStr(magic, stream, 4);
+    writeNumber<E>(totalSize, stream);
+    sec.template write<E>(stream, header);
+    writePadding(stream, totalSize - contentSize);
+}
 
 }
 
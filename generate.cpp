@@ -0,0 +1,110 @@
+#include "generator.h"
+#include <cstdio>
+#include <fstream>
+
+using namespace bq;
+using namespace bq::generator;
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: becquerel-generate [options] <out.brlyt> [out.brlan]\n"
+        "  --seed <n>              random seed (default 1)\n"
+        "  --panes <n>             pane count including the root pane\n"
+        "  --depth <n>             maximum pane tree depth\n"
+        "  --mix <a:b:c:d:e>       pan1:pic1:txt1:wnd1:bnd1 weights\n"
+        "  --materials <n>         material count\n"
+        "  --tev-stages <n>        maximum TEV stages per material\n"
+        "  --texture-maps <n>      maximum texture maps per material\n"
+        "  --textures <n>          texture count\n"
+        "  --groups <n>            group count\n"
+        "  --text-length <n>       maximum text length\n"
+        "  --entries <n>           animation entries\n"
+        "  --hermite-keys <n>      keys per Hermite curve\n"
+        "  --step-keys <n>         keys per step curve\n"
+        "  --frames <n>            animation length\n"
+        "  --little-endian         write little-endian files\n");
+}
+
+template<class Document>
+static void writeFile(Document &document, const char *path) {
+    std::ofstream file(path, std::ios::binary);
+    document.write(file);
+    if (!file) {
+        throw std::runtime_error(std::string("cannot write ") + path);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    LayoutParams layoutParams;
+    AnimationParams animationParams;
+    std::vector<const char *> outputs;
+    try {
+        for (int i=1; i<argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--little-endian") {
+                layoutParams.bigEndian = animationParams.bigEndian = false;
+                continue;
+            }
+            if (arg.compare(0, 2, "--") != 0) {
+                outputs.push_back(argv[i]);
+                continue;
+            }
+            if (i + 1 >= argc) {
+                usage();
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (arg == "--mix") {
+                std::sscanf(value.c_str(), "%u:%u:%u:%u:%u", &layoutParams.pan1Weight, &layoutParams.pic1Weight,
+                    &layoutParams.txt1Weight, &layoutParams.wnd1Weight, &layoutParams.bnd1Weight);
+                continue;
+            }
+            auto number = std::stoul(value);
+            if (arg == "--seed") {
+                layoutParams.seed = animationParams.seed = number;
+            } else if (arg == "--panes") {
+                layoutParams.paneCount = number;
+            } else if (arg == "--depth") {
+                layoutParams.maxDepth = number;
+            } else if (arg == "--materials") {
+                layoutParams.materialCount = number;
+            } else if (arg == "--tev-stages") {
+                layoutParams.maxTevStages = number;
+            } else if (arg == "--texture-maps") {
+                layoutParams.maxTextureMaps = number;
+            } else if (arg == "--textures") {
+                layoutParams.textureCount = number;
+            } else if (arg == "--groups") {
+                layoutParams.groupCount = number;
+            } else if (arg == "--text-length") {
+                layoutParams.maxTextLength = number;
+            } else if (arg == "--entries") {
+                animationParams.entryCount = number;
+            } else if (arg == "--hermite-keys") {
+                animationParams.hermiteKeys = number;
+            } else if (arg == "--step-keys") {
+                animationParams.stepKeys = number;
+            } else if (arg == "--frames") {
+                animationParams.frameCount = number;
+            } else {
+                usage();
+                return 1;
+            }
+        }
+        if (outputs.empty() || outputs.size() > 2) {
+            usage();
+            return 1;
+        }
+
+        auto layout = generateLayout(layoutParams);
+        writeFile(layout, outputs[0]);
+        if (outputs.size() > 1) {
+            auto animation = generateAnimation(animationParams, &layout);
+            writeFile(animation, outputs[1]);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,367 @@
+#include "generator.h"
+#include <random>
+
+namespace bq::generator {
+
+using namespace brlyt;
+using namespace brlan;
+
+/**
+ * @brief seeded random source
+ *
+ * std::mt19937 produces the same sequence everywhere, unlike the standard
+ * distributions, so ranges are derived from its raw output.
+ */
+class Random {
+    public:
+    explicit Random(std::uint32_t seed) : engine(seed) {};
+    /**
+     * @brief returns a value in [0, n), or 0 if n is 0
+     */
+    std::uint32_t below(std::uint64_t n) { return n ? std::uint32_t(engine() % n) : 0; };
+    /**
+     * @brief returns a value in [low, high]
+     */
+    std::uint32_t between(std::uint32_t low, std::uint32_t high) { return low + below(std::uint64_t(high) - low + 1); };
+    bool chance(unsigned percent) { return below(100) < percent; };
+    float real(float low, float high) { return low + (high - low) * float(engine() / 4294967296.0); };
+    std::uint8_t byte() { return std::uint8_t(engine()); };
+    color8 color() { return {byte(), byte(), byte(), byte()}; };
+    private:
+    std::mt19937 engine;
+};
+
+static std::uint16_t byteOrderMark(bool bigEndian) {
+    // the mark is stored in host order, so 0xfeff means the file matches the host
+    return bigEndian == (NATIVE_ENDIAN == Endian::Big) ? 0xfeff : 0xfffe;
+}
+
+static std::shared_ptr<brlyt::Material> generateMaterial(Random &random, const LayoutParams &params, const Brlyt &layout, std::size_t index) {
+    auto material = std::make_shared<brlyt::Material>();
+    material->name = "material_" + std::to_string(index);
+    material->blackColor = random.color();
+    material->whiteColor = random.color();
+    material->colorRegister3 = random.color();
+    for (auto &tevColor: material->tevColors) {
+        tevColor = random.color();
+    }
+    material->flags = 0;
+
+    auto textureMaps = layout.txl1.textures.empty() ? 0 : random.below(std::min<std::size_t>(params.maxTextureMaps, 8) + 1);
+    for (std::size_t i=0; i<textureMaps; ++i) {
+        TextureRef textureRef;
+        textureRef.name = layout.txl1.textures[random.below(layout.txl1.textures.size())];
+        textureRef.wrapModeU = WrapMode(random.below(3));
+        textureRef.wrapModeV = WrapMode(random.below(3));
+        material->textureMaps.push_back(textureRef);
+        material->texCoordGens.push_back({TexCoordGenTypes::GX_TG_MTX2x4, TexCoordGenSource::GX_TG_TEX0, TexCoordGenMatrixSource::GX_IDENTITY, 0});
+        if (random.chance(50)) {
+            material->texTransforms.push_back({{random.real(-1, 1), random.real(-1, 1)}, random.real(0, 360), {random.real(0.5f, 2), random.real(0.5f, 2)}});
+        }
+    }
+
+    auto tevStages = random.between(1, std::clamp<std::size_t>(params.maxTevStages, 1, 16));
+    for (std::size_t i=0; i<tevStages; ++i) {
+        TevStage stage;
+        stage.texCoord = textureMaps ? random.below(textureMaps) : 0xff;
+        stage.color = random.chance(50) ? 4 : 0xff;
+        stage.flag1 = random.below(0x10000);
+        for (auto &flag: stage.flags) {
+            flag = random.byte();
+        }
+        material->tevStages.push_back(stage);
+    }
+
+    if (textureMaps && random.chance(10)) {
+        material->indirectStages.push_back({0, 0, 0, 0});
+        material->indirectTransforms.push_back({{0, 0}, 0, {1, 1}});
+    }
+    material->setHasChannelControl(random.chance(50));
+    material->chanCtrl = {1, 1, 0, 0};
+    material->setHasMaterialColor(random.chance(50));
+    material->matColor = random.color();
+    material->setHasTevSwapTable(random.chance(20));
+    for (auto &swapMode: material->swapModeTable.swapModes) {
+        swapMode = {Red, Green, Blue, Alpha};
+    }
+    material->setHasAlphaCompare(random.chance(30));
+    material->alphaCompare.comp0 = AlphaFunction::Greater;
+    material->alphaCompare.comp1 = AlphaFunction::Always;
+    material->alphaCompare.op = AlphaOp::And;
+    material->alphaCompare.ref0 = random.byte();
+    material->alphaCompare.ref1 = 0;
+    material->setHasBlendMode(random.chance(70));
+    material->blendMode = {BlendMode::Op::Add, BlendMode::BlendFactor::SourceAlpha, BlendMode::BlendFactor::SourceInvAlpha, BlendMode::Op::Disable};
+    return material;
+}
+
+static void initPane(Random &random, Pan1 &pane, const std::string &name) {
+    pane.name = name;
+    pane.paneMagFlags = 0;
+    pane.userDataInfo = "";
+    pane.visible = random.chance(90);
+    pane.translate = {random.real(-320, 320), random.real(-240, 240), 0};
+    pane.rotate = {0, 0, random.chance(20) ? random.real(0, 360) : 0};
+    pane.scale = {1, 1};
+    pane.width = random.between(1, 640);
+    pane.height = random.between(1, 480);
+    pane.originX = Pan1::ORIGIN_X_MAP[random.below(3)];
+    pane.originY = Pan1::ORIGIN_Y_MAP[random.below(3)];
+    pane.parentOriginX = OriginX::LEFT;
+    pane.parentOriginY = OriginY::TOP;
+    pane.alpha = random.chance(80) ? 255 : random.byte();
+    pane.influenceAlpha = random.chance(50);
+    pane.flags = pane.visible | (pane.influenceAlpha << 1);
+}
+
+static SmallVector<TexCoord, 1> generateTexCoords(const brlyt::Material &material) {
+    // one set of coordinates per texture map, covering the whole texture
+    return SmallVector<TexCoord, 1>(material.textureMaps.size(), {{0, 0}, {1, 0}, {0, 1}, {1, 1}});
+}
+
+static std::shared_ptr<Pan1> generatePane(Random &random, const LayoutParams &params, const Brlyt &layout, std::size_t index) {
+    auto name = "pane_" + std::to_string(index);
+    unsigned weights[] = {params.pan1Weight, params.pic1Weight, params.txt1Weight, params.wnd1Weight, params.bnd1Weight};
+    unsigned totalWeight = 0;
+    for (auto weight: weights) {
+        totalWeight += weight;
+    }
+    // panes other than pan1 and bnd1 need a material
+    if (layout.mat1.materials.empty()) {
+        weights[1] = weights[2] = weights[3] = 0;
+        totalWeight = weights[0] + weights[4];
+    }
+    unsigned pick = totalWeight ? random.below(totalWeight) : 0;
+    int type = 0;
+    while (type < 4 && pick >= weights[type]) {
+        pick -= weights[type++];
+    }
+    auto &materials = layout.mat1.materials;
+
+    if (type == 1) {
+        auto pic1 = std::make_shared<Pic1>();
+        initPane(random, *pic1, name);
+        pic1->colorTopLeft = random.color();
+        pic1->colorTopRight = random.color();
+        pic1->colorBottomLeft = random.color();
+        pic1->colorBottomRight = random.color();
+        pic1->material = materials[random.below(materials.size())];
+        pic1->texCoords = generateTexCoords(*pic1->material);
+        return pic1;
+    } else if (type == 2) {
+        auto txt1 = std::make_shared<Txt1>();
+        initPane(random, *txt1, name);
+        txt1->material = materials[random.below(materials.size())];
+        txt1->font = layout.fnl1.fonts.empty() ? "" : layout.fnl1.fonts[random.below(layout.fnl1.fonts.size())];
+        auto length = random.below(params.maxTextLength + 1);
+        for (std::size_t i=0; i<length; ++i) {
+            txt1->text.push_back(random.chance(15) ? u' ' : char16_t(u'a' + random.below(26)));
+        }
+        txt1->textLen = (txt1->text.size() + 1) * 2;
+        txt1->maxTextLen = txt1->textLen;
+        txt1->textAlign = random.below(3);
+        txt1->lineAlign = LineAlign(random.below(4));
+        txt1->flagsTxt1 = 0;
+        txt1->italicTilt = 0;
+        txt1->fontTopColor = random.color();
+        txt1->fontBottomColor = random.color();
+        float fontSize = random.between(12, 48);
+        txt1->fontSize = {fontSize, fontSize};
+        txt1->charSpace = 0;
+        txt1->lineSpace = random.below(8);
+        return txt1;
+    } else if (type == 3) {
+        auto wnd1 = std::make_shared<Wnd1>();
+        initPane(random, *wnd1, name);
+        wnd1->stretchLeft = wnd1->stretchRight = random.below(16);
+        wnd1->stretchTop = wnd1->stretchBottom = random.below(16);
+        wnd1->frameElementLeft = wnd1->frameElementRight = random.below(16);
+        wnd1->frameElementTop = wnd1->frameElementBottom = random.below(16);
+        wnd1->flagsWnd1 = 0;
+        wnd1->content.colorTopLeft = random.color();
+        wnd1->content.colorTopRight = random.color();
+        wnd1->content.colorBottomLeft = random.color();
+        wnd1->content.colorBottomRight = random.color();
+        wnd1->content.material = materials[random.below(materials.size())];
+        wnd1->content.texCoords = generateTexCoords(*wnd1->content.material);
+        // windows have one, two, four or eight frames, or none
+        static const std::size_t FRAME_COUNTS[] = {0, 1, 2, 4, 8};
+        auto frameCount = FRAME_COUNTS[random.below(5)];
+        for (std::size_t i=0; i<frameCount; ++i) {
+            wnd1->frames.push_back({materials[random.below(materials.size())], WindowFrameTexFlip(random.below(3))});
+        }
+        return wnd1;
+    } else if (type == 4) {
+        auto bnd1 = std::make_shared<Bnd1>();
+        initPane(random, *bnd1, name);
+        return bnd1;
+    }
+    auto pan1 = std::make_shared<Pan1>();
+    initPane(random, *pan1, name);
+    return pan1;
+}
+
+Brlyt generateLayout(const LayoutParams &params) {
+    Random random(params.seed);
+    Brlyt layout;
+    layout.bom = byteOrderMark(params.bigEndian);
+    layout.version = 0x000a;
+    layout.headerSize = 0x10;
+    layout.lyt1.drawFromCenter = true;
+    layout.lyt1.width = 640;
+    layout.lyt1.height = 480;
+    for (std::size_t i=0; i<params.textureCount; ++i) {
+        layout.txl1.textures.push_back("texture_" + std::to_string(i) + ".tpl");
+    }
+    for (std::size_t i=0; i<params.fontCount; ++i) {
+        layout.fnl1.fonts.push_back("font_" + std::to_string(i) + ".brfnt");
+    }
+    layout.mat1.materials.reserve(params.materialCount);
+    for (std::size_t i=0; i<params.materialCount; ++i) {
+        layout.mat1.materials.push_back(generateMaterial(random, params, layout, i));
+    }
+
+    auto root = std::make_shared<Pan1>();
+    initPane(random, *root, "RootPane");
+    root->translate = {0, 0, 0};
+    root->width = layout.lyt1.width;
+    root->height = layout.lyt1.height;
+    layout.rootPane = root;
+    // panes that may still get children, with their depth
+    std::vector<std::pair<std::shared_ptr<BasePane>, std::size_t>> parents = {{root, 0}};
+    std::vector<FixedName<0x10>> paneNames;
+    paneNames.reserve(params.paneCount);
+    for (std::size_t i=1; i<params.paneCount && params.maxDepth > 0; ++i) {
+        auto [parent, depth] = parents[random.below(parents.size())];
+        auto pane = generatePane(random, params, layout, i);
+        parent->children.push_back(pane);
+        pane->parent = parent;
+        paneNames.push_back(pane->name);
+        if (depth + 1 < params.maxDepth) {
+            parents.emplace_back(pane, depth + 1);
+        }
+    }
+    layout.rebuildPaneTable();
+
+    auto rootGroup = std::make_shared<Grp1>();
+    rootGroup->name = "RootGroup";
+    layout.rootGroup = rootGroup;
+    for (std::size_t i=0; i<params.groupCount; ++i) {
+        auto group = std::make_shared<Grp1>();
+        group->name = "group_" + std::to_string(i);
+        auto members = paneNames.empty() ? 0 : random.between(1, std::min<std::size_t>(paneNames.size(), 8));
+        for (std::size_t j=0; j<members; ++j) {
+            group->panes.push_back(paneNames[random.below(paneNames.size())]);
+        }
+        group->parent = rootGroup;
+        rootGroup->children.push_back(group);
+    }
+    return layout;
+}
+
+static PaiTagEntry generateCurve(Random &random, std::uint8_t target, CurveType curveType, std::size_t keyCount, std::uint16_t frameCount, std::uint32_t maxStepValue) {
+    PaiTagEntry curve = {0, target, curveType, {}};
+    curve.keyFrames.reserve(keyCount);
+    for (std::size_t i=0; i<keyCount; ++i) {
+        float frame = keyCount > 1 ? float(i) * frameCount / (keyCount - 1) : 0;
+        if (curveType == CurveType::Hermite) {
+            curve.keyFrames.push_back({frame, random.real(-100, 100), random.real(-5, 5)});
+        } else {
+            // step keys store their value as an integer
+            curve.keyFrames.push_back({frame, float(random.below(maxStepValue + 1)), 0});
+        }
+    }
+    return curve;
+}
+
+static PaiTag generateTag(Random &random, const char *name, std::size_t curveCount, std::uint8_t targetCount, CurveType curveType, std::size_t keyCount, std::uint16_t frameCount, std::uint32_t maxStepValue) {
+    PaiTag tag;
+    tag.tag = name;
+    tag.unknown = 0;
+    // every curve animates a different target
+    auto firstTarget = random.below(targetCount - curveCount + 1);
+    for (std::size_t i=0; i<curveCount; ++i) {
+        tag.tagEntries.push_back(generateCurve(random, firstTarget + i, curveType, keyCount, frameCount, maxStepValue));
+    }
+    return tag;
+}
+
+Brlan generateAnimation(const AnimationParams &params, const Brlyt *layout) {
+    Random random(params.seed);
+    Brlan animation;
+    animation.bom = byteOrderMark(params.bigEndian);
+    animation.version = 0x0008;
+    animation.headerSize = 0x10;
+
+    std::vector<std::string> paneNames, materialNames, groupNames;
+    if (layout) {
+        for (auto &entry: layout->paneTable) {
+            paneNames.push_back(entry.first.str());
+        }
+        // the table is unordered, so sort to stay deterministic
+        std::sort(paneNames.begin(), paneNames.end());
+        for (auto &material: layout->mat1.materials) {
+            materialNames.push_back(material->name.str());
+        }
+        if (layout->rootGroup) {
+            for (auto &group: layout->rootGroup->children) {
+                groupNames.push_back(group->name.str());
+            }
+        }
+    } else {
+        for (std::size_t i=0; i<params.entryCount; ++i) {
+            paneNames.push_back("pane_" + std::to_string(i + 1));
+            materialNames.push_back("material_" + std::to_string(i));
+        }
+        groupNames.push_back("group_0");
+    }
+
+    auto &tag = animation.animationTag;
+    tag.name = "anim_" + std::to_string(params.seed);
+    tag.animationOrder = 2;
+    tag.startFrame = 0;
+    tag.endFrame = params.frameCount;
+    tag.childBinding = false;
+    if (!groupNames.empty()) {
+        tag.groups.emplace_back(groupNames[random.below(groupNames.size())]);
+    }
+
+    auto &info = animation.animationInfo;
+    info.frameSize = params.frameCount;
+    info.loop = random.chance(50);
+    if (params.stepKeys) {
+        for (std::size_t i=0; i<4; ++i) {
+            info.textures.push_back("pattern_" + std::to_string(i) + ".tpl");
+        }
+    }
+    info.entries.reserve(params.entryCount);
+    std::size_t nextPane = 0, nextMaterial = 0;
+    for (std::size_t i=0; i<params.entryCount; ++i) {
+        PaiEntry entry;
+        bool material = !materialNames.empty() && (paneNames.empty() || random.chance(params.materialPercent));
+        if (!material && paneNames.empty()) {
+            break;
+        }
+        if (material) {
+            entry.name = materialNames[nextMaterial++ % materialNames.size()];
+            entry.target = AnimationTarget::Material;
+            // material colors, then the texture pattern
+            entry.tags.push_back(generateTag(random, "RLMC", random.between(1, 4), 8, CurveType::Hermite, params.hermiteKeys, params.frameCount, 0));
+            if (params.stepKeys) {
+                entry.tags.push_back(generateTag(random, "RLTP", 1, 1, CurveType::Step, params.stepKeys, params.frameCount, info.textures.size() - 1));
+            }
+        } else {
+            entry.name = paneNames[nextPane++ % paneNames.size()];
+            entry.target = AnimationTarget::Pane;
+            // translation, rotation and scale, then the visibility
+            entry.tags.push_back(generateTag(random, "RLPA", random.between(1, 3), 10, CurveType::Hermite, params.hermiteKeys, params.frameCount, 0));
+            if (params.stepKeys) {
+                entry.tags.push_back(generateTag(random, "RLVI", 1, 1, CurveType::Step, params.stepKeys, params.frameCount, 1));
+            }
+        }
+        info.entries.push_back(std::move(entry));
+    }
+    return animation;
+}
+
+}
@@ -0,0 +1,60 @@
+#include "brlyt.h"
+#include "brlan.h"
+
+#ifndef BECQUEREL_GENERATOR_H
+#define BECQUEREL_GENERATOR_H
+
+namespace bq::generator {
+
+/**
+ * @brief shape of a synthetic layout
+ */
+struct LayoutParams {
+    std::uint32_t seed = 1;
+    std::size_t paneCount = 256; // including the root pane
+    std::size_t maxDepth = 4; // levels below the root pane
+    // relative weights of the pane types below the root pane
+    unsigned pan1Weight = 2;
+    unsigned pic1Weight = 4;
+    unsigned txt1Weight = 3;
+    unsigned wnd1Weight = 1;
+    unsigned bnd1Weight = 1;
+    std::size_t materialCount = 32;
+    std::size_t maxTevStages = 4; // at most 16
+    std::size_t maxTextureMaps = 2; // at most 8
+    std::size_t textureCount = 16;
+    std::size_t fontCount = 2;
+    std::size_t groupCount = 8;
+    std::size_t maxTextLength = 32;
+    bool bigEndian = true;
+};
+
+/**
+ * @brief shape of a synthetic animation
+ */
+struct AnimationParams {
+    std::uint32_t seed = 1;
+    std::size_t entryCount = 64;
+    unsigned materialPercent = 25; // share of entries that animate materials
+    std::size_t hermiteKeys = 16; // keys per Hermite curve
+    std::size_t stepKeys = 4; // keys per visibility or texture pattern curve, 0 for none
+    std::uint16_t frameCount = 120;
+    bool bigEndian = true;
+};
+
+/**
+ * @brief builds a valid layout; the same parameters always give the same layout
+ */
+brlyt::Brlyt generateLayout(const LayoutParams &params);
+
+/**
+ * @brief builds a valid animation; the same parameters always give the same animation
+ *
+ * With a layout, the entries animate its panes and materials and the tag
+ * binds its groups. Without one, they use the names generateLayout gives.
+ */
+brlan::Brlan generateAnimation(const AnimationParams &params, const brlyt::Brlyt *layout = nullptr);
+
+}
+
+#endif
@@ -10,11 +10,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    ifstream fs(argv[1], std::ios::binary | std::ios::in);
     ofstream fs1(argv[2], std::ios::binary | std::ios::out);
 
     Brlan brlan;
-    brlan.read(fs);
+    brlan.loadFile(argv[1]);
 
     cout << boolalpha;
     cout << "bom: " << hex << brlan.bom << dec << endl;
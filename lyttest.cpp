@@ -12,10 +12,9 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> conv;
-    ifstream fs(argv[1], std::ios::binary | std::ios::in);
     ofstream fs1(argv[2], std::ios::binary | std::ios::out);
     Brlyt brlyt;
-    brlyt.read(fs);
+    brlyt.loadFile(argv[1]);
     cout << boolalpha;
     cout << "bom: " << hex << brlyt.bom << dec << endl;
     cout << "headersize: " << brlyt.headerSize << endl;
@@ -28,15 +27,12 @@ int main(int argc, char *argv[]) {
     for (int i=0; i<mat1.materials.size(); ++i) {
         cout << "material at " << i << ": " << mat1.materials[i]->name << " (flag = " << hex << mat1.materials[i]->flags << ")" << endl;
     }
-    #if 0
     for (auto &entry: brlyt.paneTable) {
         cout << "pane_name: " << entry.first << endl;
-        auto txt1 = dynamic_pointer_cast<Txt1>(entry.second);
-        if (txt1) {
-            cout << "text: " << conv.to_bytes(txt1->text) << endl;
+        if (entry.second->kind == bq::PaneKind::Text) {
+            cout << "text: " << conv.to_bytes(static_cast<Txt1 &>(*entry.second).text) << endl;
         }
     }
-    #endif
     
     brlyt.write(fs1);
 
@@ -0,0 +1,235 @@
+#include "test.h"
+#include "brlyt.h"
+#include <atomic>
+#include <cstdlib>
+
+using namespace bq;
+
+// counts every allocation in the test binary, so tests can check that a path does not allocate
+static std::atomic<std::size_t> allocationCount{0};
+
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+TEST(containers, flatTree) {
+    auto root = std::make_shared<brlyt::Pan1>();
+    root->name = "RootPane";
+    auto a = std::make_shared<brlyt::Pan1>();
+    a->name = "A";
+    auto b = std::make_shared<brlyt::Pic1>();
+    b->name = "B";
+    auto c = std::make_shared<brlyt::Pan1>();
+    c->name = "C";
+    brlyt::Brlyt layout;
+    layout.addPane(root, nullptr);
+    layout.addPane(a, root);
+    layout.addPane(b, a);
+    layout.addPane(c, root);
+
+    FlatPaneTree tree(layout.rootPane);
+    CHECK(tree.size() == layout.paneTable.size());
+    CHECK(tree[0].pane == root.get());
+    CHECK(tree[0].parent == FlatPaneTree::NONE);
+    CHECK(tree[1].pane == a.get() && tree[1].parent == 0);
+    CHECK(tree[2].pane == b.get() && tree[2].type == brlyt::Pic1::FOURCC);
+    CHECK(tree[0].firstChild == 1 && tree[1].nextSibling == 3);
+    CHECK(tree[1].subtreeEnd == 3);
+
+    std::vector<std::uint32_t> order;
+    tree.forEachBreadthFirst([&](std::uint32_t i, const FlatPaneTree::Node &) { order.push_back(i); });
+    CHECK((order == std::vector<std::uint32_t>{0, 1, 3, 2}));
+    order.clear();
+    tree.forEachDepthFirst([&](std::uint32_t i, const FlatPaneTree::Node &) {
+        order.push_back(i);
+        return i != 1;
+    });
+    CHECK((order == std::vector<std::uint32_t>{0, 1, 3}));
+
+    root->children.clear();
+    CHECK(tree.toTree() == root);
+    CHECK(root->children.size() == 2);
+    CHECK(b->parent.lock() == a);
+}
+
+TEST(containers, bitRange) {
+    using TexCount = BitRange<std::uint32_t, 28, 4>;
+    using HasBlendMode = BitRange<std::uint32_t, 7, 1>;
+    static_assert(TexCount::MASK == 0xf);
+    std::uint32_t flags = 0;
+    flags = TexCount::set(flags, 5);
+    flags = HasBlendMode::set(flags, 1);
+    CHECK(TexCount::get(flags) == 5);
+    CHECK(HasBlendMode::get(flags) == 1);
+    // bits past the range are dropped instead of spilling into the neighbours
+    flags = TexCount::set(flags, 0x1f);
+    CHECK(TexCount::get(flags) == 0xf);
+    CHECK(HasBlendMode::get(flags) == 1);
+
+    brlyt::Material material{};
+    material.flags = 0;
+    material.setTexCount(3);
+    material.setTevStagesCount(16);
+    CHECK(material.texCount() == 3);
+    CHECK(material.tevStagesCount() == 16);
+}
+
+TEST(containers, smallVectorInline) {
+    SmallVector<int, 4> values;
+    CHECK(values.empty());
+    CHECK(values.capacity() == 4);
+    auto inlineData = values.data();
+    for (int i=0; i<4; ++i) {
+        values.push_back(i);
+    }
+    CHECK(values.data() == inlineData);
+    CHECK(values.size() == 4);
+    CHECK(values.front() == 0 && values.back() == 3);
+    values.pop_back();
+    CHECK(values.size() == 3);
+    values.resize(6, 9);
+    CHECK(values.size() == 6 && values[5] == 9);
+    CHECK(values.data() != inlineData);
+}
+
+TEST(containers, smallVectorSpill) {
+    SmallVector<std::string, 2> values;
+    for (int i=0; i<10; ++i) {
+        values.emplace_back(std::string(32, char('a' + i)));
+    }
+    CHECK(values.size() == 10);
+    CHECK(values.capacity() >= 10);
+    for (int i=0; i<10; ++i) {
+        CHECK(values[i] == std::string(32, char('a' + i)));
+    }
+    // growing from an element of the vector itself
+    values.push_back(values[0]);
+    CHECK(values.back() == values.front());
+}
+
+TEST(containers, smallVectorCopyAndMove) {
+    for (std::size_t count: {1, 2, 5}) {
+        SmallVector<std::string, 2> values;
+        for (std::size_t i=0; i<count; ++i) {
+            values.push_back(std::to_string(i));
+        }
+        auto copy = values;
+        CHECK(copy == values);
+        auto moved = std::move(copy);
+        CHECK(moved == values);
+        CHECK(copy.empty());
+        SmallVector<std::string, 2> assigned{"x"};
+        assigned = values;
+        CHECK(assigned == values);
+        assigned = std::move(moved);
+        CHECK(assigned == values);
+        assigned = assigned;
+        CHECK(assigned == values);
+    }
+}
+
+TEST(containers, smallVectorInsertErase) {
+    SmallVector<int, 3> values{1, 2, 4};
+    auto it = values.insert(values.begin() + 2, 3);
+    CHECK(*it == 3);
+    CHECK((values == SmallVector<int, 3>{1, 2, 3, 4}));
+    values.insert(values.begin(), 0);
+    values.insert(values.end(), 5);
+    CHECK((values == SmallVector<int, 3>{0, 1, 2, 3, 4, 5}));
+    it = values.erase(values.begin());
+    CHECK(*it == 1);
+    it = values.erase(values.begin() + 1, values.begin() + 3);
+    CHECK(*it == 4);
+    CHECK((values == SmallVector<int, 3>{1, 4, 5}));
+    CHECK((values != SmallVector<int, 3>{1, 4}));
+    values.erase(values.begin(), values.end());
+    CHECK(values.empty());
+}
+
+TEST(containers, fixedName) {
+    FixedName<0x10> name("N_Root");
+    CHECK(name.size() == 6);
+    CHECK(name == std::string_view("N_Root"));
+    CHECK(name.str() == "N_Root");
+    CHECK(name == FixedName<0x10>("N_Root"));
+    CHECK(name != FixedName<0x10>("N_Roots"));
+    CHECK(name.hash() == FixedName<0x10>("N_Root").hash());
+    // names that only differ in trailing NULs have the same words but not the same length
+    FixedName<0x10> padded(std::string_view("N_Root\0", 7));
+    CHECK(padded.size() == 7);
+    CHECK(padded != name);
+    CHECK(!(padded == name));
+    CHECK(padded != std::string_view("N_Root"));
+    CHECK(padded.hash() != name.hash());
+    std::unordered_map<FixedName<0x10>, int, FixedName<0x10>::Hash> names{{name, 1}, {padded, 2}};
+    CHECK(names.size() == 2);
+    CHECK(names.at(name) == 1 && names.at(padded) == 2);
+    FixedName<0x10> full(std::string(0x10, 'x'));
+    CHECK(full.size() == 0x10);
+    CHECK_THROWS(name = std::string(0x11, 'x'), std::length_error);
+    CHECK(name == std::string_view("N_Root"));
+
+    std::vector<char> buffer(0x10, 0);
+    std::memcpy(buffer.data(), "pic", 3);
+    BinaryReader reader(buffer.data(), buffer.size());
+    auto read = readFixedName<0x10>(reader);
+    CHECK(read == std::string_view("pic"));
+    BinaryWriter writer;
+    writeFixedName(read, writer);
+    CHECK(writer.size() == 0x10);
+}
+
+TEST(containers, maximalMaterialDecodesWithoutAllocating) {
+    brlyt::Brlyt layout;
+    // short enough for the small string optimization, so copying a name does not allocate
+    for (std::size_t i=0; i<MAX_TEXTURE_MAPS; ++i) {
+        layout.txl1.textures.push_back("t" + std::to_string(i) + ".tpl");
+    }
+    brlyt::Material material{};
+    material.name = "maximal";
+    material.flags = 0;
+    for (std::size_t i=0; i<MAX_TEXTURE_MAPS; ++i) {
+        brlyt::TextureRef textureRef;
+        textureRef.name = layout.txl1.textures[i];
+        textureRef.wrapModeU = WrapMode(0);
+        textureRef.wrapModeV = WrapMode(0);
+        material.textureMaps.push_back(textureRef);
+    }
+    material.texTransforms.resize(MAX_TEXTURE_MATRICES, {{0, 0}, 0, {1, 1}});
+    material.texCoordGens.resize(MAX_TEX_COORD_GENS, {});
+    material.indirectTransforms.resize(MAX_INDIRECT_TRANSFORMS, {{0, 0}, 0, {1, 1}});
+    material.indirectStages.resize(MAX_INDIRECT_STAGES, {});
+    material.tevStages.resize(MAX_TEV_STAGES, {});
+    material.setHasChannelControl(true);
+    material.setHasMaterialColor(true);
+    material.setHasTevSwapTable(true);
+    material.setHasAlphaCompare(true);
+    material.setHasBlendMode(true);
+    BinaryWriter writer;
+    material.write<NATIVE_ENDIAN>(writer, layout);
+    auto buffer = writer.release();
+
+    brlyt::Material decoded;
+    BinaryReader reader(buffer.data(), buffer.size());
+    auto before = allocationCount.load();
+    decoded.read<NATIVE_ENDIAN>(reader, layout);
+    CHECK(allocationCount.load() == before);
+
+    CHECK(decoded.tevStages.size() == MAX_TEV_STAGES);
+    CHECK(decoded.indirectStages.size() == MAX_INDIRECT_STAGES);
+    BinaryWriter rewriter;
+    decoded.write<NATIVE_ENDIAN>(rewriter, layout);
+    CHECK(rewriter.release() == buffer);
+}
@@ -0,0 +1,37 @@
+#include "test.h"
+#include <cstdio>
+
+namespace bq::test {
+
+std::vector<TestCase> &registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+void fail(const char *file, int line, const char *expression) {
+    throw Failure(std::string(file) + ":" + std::to_string(line) + ": CHECK(" + expression + ") failed");
+}
+
+}
+
+// usage: becquerel-tests [suite]
+int main(int argc, char *argv[]) {
+    const char *suite = argc > 1 ? argv[1] : nullptr;
+    int run = 0, failed = 0;
+    for (auto &test: bq::test::registry()) {
+        if (suite && std::string(suite) != test.suite) {
+            continue;
+        }
+        ++run;
+        try {
+            test.run();
+        } catch (const std::exception &e) {
+            ++failed;
+            std::printf("FAIL %s.%s: %s\n", test.suite, test.name, e.what());
+            continue;
+        }
+        std::printf("ok   %s.%s\n", test.suite, test.name);
+    }
+    std::printf("%d tests, %d failed\n", run, failed);
+    return run == 0 || failed ? 1 : 0;
+}
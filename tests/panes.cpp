@@ -0,0 +1,98 @@
+#include "test.h"
+#include "brlyt.h"
+
+using namespace bq;
+using namespace bq::brlyt;
+
+// only the concrete types may choose a kind, otherwise visitPane could cast to the wrong type
+static_assert(!std::is_constructible_v<Pan1, PaneKind>, "Pan1 must not take an arbitrary PaneKind");
+static_assert(std::is_default_constructible_v<Pan1> && std::is_default_constructible_v<Pic1>);
+
+TEST(panes, visitPaneDispatchesOnKind) {
+    std::vector<std::shared_ptr<BasePane>> panes = {
+        std::make_shared<Pan1>(), std::make_shared<Pic1>(), std::make_shared<Txt1>(),
+        std::make_shared<Bnd1>(), std::make_shared<Wnd1>()};
+    std::vector<std::string_view> expected = {Pan1::MAGIC, Pic1::MAGIC, Txt1::MAGIC, Bnd1::MAGIC, Wnd1::MAGIC};
+    for (std::size_t i=0; i<panes.size(); ++i) {
+        CHECK(panes[i]->signature() == expected[i]);
+        auto visited = visitPane(*panes[i], [](auto &pane) { return std::decay_t<decltype(pane)>::MAGIC; });
+        CHECK(visited == expected[i]);
+    }
+}
+
+static std::shared_ptr<Pan1> namedPane(std::string_view name) {
+    auto pane = std::make_shared<Pan1>();
+    pane->name = FixedName<0x10>(name);
+    return pane;
+}
+
+TEST(panes, addPane) {
+    Brlyt layout;
+    auto root = namedPane("RootPane");
+    auto child = namedPane("child");
+    auto grandchild = namedPane("grandchild");
+    child->children.push_back(grandchild);
+    grandchild->parent = child;
+    layout.addPane(root, nullptr);
+    layout.addPane(child, root);
+    CHECK(layout.rootPane == root);
+    CHECK(layout.findPane("child") == child);
+    CHECK(layout.findPane("grandchild") == grandchild);
+    CHECK(child->parent.lock() == root);
+
+    // moving a pane takes it out of its old parent
+    auto other = namedPane("other");
+    layout.addPane(other, root);
+    layout.addPane(child, other);
+    CHECK(root->children.size() == 1 && root->children[0] == other);
+    CHECK(other->children.size() == 1 && other->children[0] == child);
+    CHECK(child->parent.lock() == other);
+    CHECK(layout.findPane("grandchild") == grandchild);
+
+    CHECK_THROWS(layout.addPane(other, grandchild), std::invalid_argument);
+    CHECK(other->parent.lock() == root);
+}
+
+TEST(panes, removePane) {
+    Brlyt layout;
+    auto root = namedPane("RootPane");
+    auto child = namedPane("child");
+    auto grandchild = namedPane("grandchild");
+    layout.addPane(root, nullptr);
+    layout.addPane(child, root);
+    layout.addPane(grandchild, child);
+    layout.removePane(child);
+    CHECK(root->children.empty());
+    CHECK(child->parent.expired());
+    CHECK(layout.findPane("child") == nullptr);
+    CHECK(layout.findPane("grandchild") == nullptr);
+    CHECK(layout.findPane("RootPane") == root);
+    layout.removePane(root);
+    CHECK(layout.rootPane == nullptr);
+    CHECK(layout.paneTable.empty());
+}
+
+TEST(panes, renamePane) {
+    Brlyt layout;
+    auto root = namedPane("RootPane");
+    auto first = namedPane("first");
+    auto second = namedPane("second");
+    layout.addPane(root, nullptr);
+    layout.addPane(first, root);
+    layout.addPane(second, root);
+    layout.renamePane(first, "renamed");
+    CHECK(layout.findPane("first") == nullptr);
+    CHECK(layout.findPane("renamed") == first);
+    layout.renamePane(first, "renamed");
+    CHECK(layout.findPane("renamed") == first);
+
+    CHECK_THROWS(layout.renamePane(first, "second"), std::invalid_argument);
+    CHECK(first->name == FixedName<0x10>("renamed"));
+    CHECK(layout.findPane("renamed") == first);
+    CHECK(layout.findPane("second") == second);
+
+    // a pane outside the tree is renamed but not indexed
+    auto loose = namedPane("loose");
+    layout.renamePane(loose, "stillLoose");
+    CHECK(layout.findPane("stillLoose") == nullptr);
+}
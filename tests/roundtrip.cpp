@@ -0,0 +1,402 @@
+#include "test.h"
+#include "generator.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace bq;
+using namespace bq::generator;
+
+static std::vector<LayoutParams> layoutCorpus() {
+    std::vector<LayoutParams> corpus;
+    for (bool bigEndian: {true, false}) {
+        for (std::uint32_t seed: {1u, 2u, 3u}) {
+            LayoutParams params;
+            params.seed = seed;
+            params.paneCount = 64 * seed;
+            params.materialCount = 8 * seed;
+            params.bigEndian = bigEndian;
+            corpus.push_back(params);
+        }
+        // the most stages and texture maps a material can have
+        LayoutParams wide;
+        wide.seed = 7;
+        wide.maxTevStages = 16;
+        wide.maxTextureMaps = 8;
+        wide.bigEndian = bigEndian;
+        corpus.push_back(wide);
+    }
+    return corpus;
+}
+
+static std::vector<AnimationParams> animationCorpus() {
+    std::vector<AnimationParams> corpus;
+    for (bool bigEndian: {true, false}) {
+        for (std::uint32_t seed: {1u, 2u, 3u}) {
+            AnimationParams params;
+            params.seed = seed;
+            params.entryCount = 32 * seed;
+            params.stepKeys = seed == 2 ? 0 : 4;
+            params.bigEndian = bigEndian;
+            corpus.push_back(params);
+        }
+    }
+    return corpus;
+}
+
+template<class Document>
+static std::vector<char> reserialize(const std::vector<char> &buffer, const ReadOptions &options = ReadOptions()) {
+    Document document;
+    document.readOptions = options;
+    document.read(buffer.data(), buffer.size());
+    return document.serialize();
+}
+
+TEST(roundtrip, layouts) {
+    for (auto &params: layoutCorpus()) {
+        auto buffer = generateLayout(params).serialize();
+        CHECK(reserialize<brlyt::Brlyt>(buffer) == buffer);
+    }
+}
+
+TEST(roundtrip, animations) {
+    for (auto &params: animationCorpus()) {
+        auto buffer = generateAnimation(params).serialize();
+        CHECK(reserialize<brlan::Brlan>(buffer) == buffer);
+    }
+}
+
+TEST(roundtrip, animationsForLayout) {
+    for (auto &layoutParams: layoutCorpus()) {
+        auto layout = generateLayout(layoutParams);
+        AnimationParams params;
+        params.bigEndian = layoutParams.bigEndian;
+        auto buffer = generateAnimation(params, &layout).serialize();
+        CHECK(reserialize<brlan::Brlan>(buffer) == buffer);
+    }
+}
+
+TEST(roundtrip, layoutsFromStream) {
+    for (auto &params: layoutCorpus()) {
+        auto buffer = generateLayout(params).serialize();
+        std::istringstream stream(std::string(buffer.begin(), buffer.end()));
+        brlyt::Brlyt layout;
+        layout.read(stream);
+        std::ostringstream out;
+        layout.write(out);
+        CHECK(out.str() == std::string(buffer.begin(), buffer.end()));
+    }
+}
+
+TEST(roundtrip, writeIndexClearedOnThrow) {
+    auto buffer = generateLayout(LayoutParams()).serialize();
+    brlyt::Brlyt layout;
+    layout.readOptions.lazyMaterials = true;
+    layout.read(buffer.data(), buffer.size());
+    // lazy materials cannot be written in the other byte order, so serialize throws halfway
+    layout.bom = layout.bom == 0xfeff ? 0xfffe : 0xfeff;
+    CHECK_THROWS(layout.serialize(), std::logic_error);
+    auto second = layout.mat1.materials[1];
+    layout.mat1.materials.erase(layout.mat1.materials.begin());
+    CHECK(layout.materialIndex(second) == 0);
+}
+
+TEST(roundtrip, dedupMaterials) {
+    for (auto &params: layoutCorpus()) {
+        auto layout = generateLayout(params);
+        auto before = layout.serialize();
+        auto saved = layout.dedupMaterials();
+        auto after = layout.serialize();
+        CHECK(after.size() + saved == before.size());
+        CHECK(reserialize<brlyt::Brlyt>(after) == after);
+    }
+}
+
+TEST(roundtrip, userData) {
+    for (bool bigEndian: {true, false}) {
+        LayoutParams params;
+        params.bigEndian = bigEndian;
+        auto layout = generateLayout(params);
+        std::size_t attached = 0;
+        for (auto &entry: layout.paneTable) {
+            brlyt::visitPane(*entry.second, [&](brlyt::Pan1 &pane) {
+                if (attached++ % 3 == 0) {
+                    pane.userData.emplace();
+                    pane.userData->data = {'u', 's', 'd', char(attached)};
+                }
+            });
+        }
+        auto buffer = layout.serialize();
+        CHECK(reserialize<brlyt::Brlyt>(buffer) == buffer);
+    }
+}
+
+/**
+ * @brief usd1 data with a string, an int32 and a float entry in the given byte order
+ */
+static std::vector<char> writeMaterial(brlyt::Material &material, const brlyt::Brlyt &layout) {
+    BinaryWriter writer;
+    withEndian(layout.revEndian(), [&](auto endian) {
+        material.write<decltype(endian)::value>(writer, layout);
+    });
+    return writer.release();
+}
+
+static std::vector<char> userDataEntries(bool revEndian) {
+    BinaryWriter writer;
+    writeNumber(std::uint16_t(3), writer, revEndian);
+    writeNumber(std::uint16_t(0), writer, revEndian);
+    // records are 0xc bytes and each value block is 8 bytes, after a 4 byte name
+    const std::uint8_t types[] = {0, 1, 2};
+    const std::uint16_t counts[] = {8, 2, 2};
+    for (std::uint32_t i=0; i<3; ++i) {
+        std::uint32_t record = 4 + i * 0xc;
+        std::uint32_t name = 4 + 3 * 0xc + i * 12;
+        writeNumber(name - record, writer, revEndian);
+        writeNumber(name + 4 - record, writer, revEndian);
+        writeNumber(counts[i], writer, revEndian);
+        writeNumber(types[i], writer, revEndian);
+        writer.put('\0');
+    }
+    writer.write("str\0abcdefgh", 12);
+    writer.write("int\0", 4);
+    writeNumber(std::int32_t(1), writer, revEndian);
+    writeNumber(std::int32_t(0x01020304), writer, revEndian);
+    writer.write("flt\0", 4);
+    writeNumber(1.5f, writer, revEndian);
+    writeNumber(-2.0f, writer, revEndian);
+    return writer.release();
+}
+
+TEST(roundtrip, userDataSwapEndian) {
+    auto flip = [](BaseHeader &document) {
+        document.bom = document.bom == 0xfeff ? 0xfffe : 0xfeff;
+    };
+    for (bool bigEndian: {true, false}) {
+        LayoutParams params;
+        params.bigEndian = bigEndian;
+        auto layout = generateLayout(params);
+        auto &pane = static_cast<brlyt::Pan1 &>(*layout.rootPane);
+        pane.userData.emplace();
+        pane.userData->data = userDataEntries(layout.revEndian());
+        auto buffer = layout.serialize();
+
+        brlyt::Brlyt swapped;
+        swapped.read(buffer.data(), buffer.size());
+        flip(swapped);
+        auto swappedBuffer = swapped.serialize();
+        brlyt::Brlyt other;
+        other.read(swappedBuffer.data(), swappedBuffer.size());
+        CHECK(other.revEndian() != layout.revEndian());
+        auto &userData = static_cast<brlyt::Pan1 &>(*other.rootPane).userData;
+        CHECK(userData.has_value());
+        CHECK(userData->data == userDataEntries(other.revEndian()));
+        flip(other);
+        CHECK(other.serialize() == buffer);
+
+        // one entry is announced but its record is missing, so the data cannot be swapped
+        static_cast<brlyt::Pan1 &>(*swapped.rootPane).userData->data = {0, 1, 0, 1};
+        CHECK_THROWS(swapped.serialize(), std::runtime_error);
+    }
+}
+
+/**
+ * @brief file in the temporary directory that is removed again at the end of the scope
+ */
+struct TemporaryFile {
+    std::filesystem::path path;
+    explicit TemporaryFile(const std::string &name, const std::vector<char> &contents)
+        : path(std::filesystem::temp_directory_path() / ("becquerel-tests-" + name)) {
+        std::ofstream out(path, std::ios::binary);
+        out.write(contents.data(), contents.size());
+    };
+    ~TemporaryFile() {
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    };
+};
+
+TEST(roundtrip, loadFile) {
+    for (bool bigEndian: {true, false}) {
+        LayoutParams layoutParams;
+        layoutParams.bigEndian = bigEndian;
+        auto layoutBuffer = generateLayout(layoutParams).serialize();
+        brlyt::Brlyt layout;
+        {
+            TemporaryFile file("layout.brlyt", layoutBuffer);
+            layout.loadFile(file.path.string());
+        }
+        // the file is unmapped and gone, so the layout must not refer to it any more
+        CHECK(layout.serialize() == reserialize<brlyt::Brlyt>(layoutBuffer));
+        CHECK(layout.serialize() == layoutBuffer);
+
+        AnimationParams animationParams;
+        animationParams.bigEndian = bigEndian;
+        auto animationBuffer = generateAnimation(animationParams).serialize();
+        brlan::Brlan animation;
+        {
+            TemporaryFile file("animation.brlan", animationBuffer);
+            animation.loadFile(file.path.string());
+        }
+        CHECK(animation.serialize() == reserialize<brlan::Brlan>(animationBuffer));
+        CHECK(animation.serialize() == animationBuffer);
+    }
+}
+
+TEST(roundtrip, loadFileMissing) {
+    auto path = (std::filesystem::temp_directory_path() / "becquerel-tests-missing.brlyt").string();
+    brlyt::Brlyt layout;
+    CHECK_THROWS(layout.loadFile(path), std::system_error);
+    brlan::Brlan animation;
+    CHECK_THROWS(animation.loadFile(path), std::system_error);
+}
+
+TEST(roundtrip, loadFileEmpty) {
+    TemporaryFile file("empty.brlyt", {});
+    MappedFile mapping(file.path.string());
+    CHECK(mapping.size() == 0);
+    brlyt::Brlyt layout;
+    CHECK_THROWS(layout.loadFile(file.path.string()), std::out_of_range);
+    brlan::Brlan animation;
+    CHECK_THROWS(animation.loadFile(file.path.string()), std::out_of_range);
+}
+
+// parallelFor gives every thread at least 16 items, so 4 threads need 64 or more
+constexpr unsigned TEST_THREADS = 4;
+constexpr std::size_t THREADED_ITEMS = 16 * TEST_THREADS * 4;
+
+TEST(roundtrip, layoutsThreaded) {
+    ReadOptions serial;
+    ReadOptions threaded;
+    threaded.threads = TEST_THREADS;
+    for (bool bigEndian: {true, false}) {
+        for (std::uint32_t seed: {1u, 2u}) {
+            LayoutParams params;
+            params.seed = seed;
+            params.materialCount = THREADED_ITEMS + seed;
+            params.maxTevStages = 16;
+            params.maxTextureMaps = 8;
+            params.bigEndian = bigEndian;
+            auto buffer = generateLayout(params).serialize();
+            auto expected = reserialize<brlyt::Brlyt>(buffer, serial);
+            CHECK(expected == buffer);
+            CHECK(reserialize<brlyt::Brlyt>(buffer, threaded) == expected);
+        }
+    }
+}
+
+TEST(roundtrip, animationsThreaded) {
+    ReadOptions serial;
+    ReadOptions threaded;
+    threaded.threads = TEST_THREADS;
+    for (bool bigEndian: {true, false}) {
+        for (std::uint32_t seed: {1u, 2u}) {
+            AnimationParams params;
+            params.seed = seed;
+            params.entryCount = THREADED_ITEMS + seed;
+            params.bigEndian = bigEndian;
+            auto buffer = generateAnimation(params).serialize();
+            auto expected = reserialize<brlan::Brlan>(buffer, serial);
+            CHECK(expected == buffer);
+            CHECK(reserialize<brlan::Brlan>(buffer, threaded) == expected);
+        }
+    }
+}
+
+TEST(roundtrip, layoutsLazy) {
+    ReadOptions options;
+    options.lazyMaterials = true;
+    for (auto &params: layoutCorpus()) {
+        auto buffer = generateLayout(params).serialize();
+        CHECK(reserialize<brlyt::Brlyt>(buffer, options) == buffer);
+
+        brlyt::Brlyt layout;
+        layout.readOptions = options;
+        layout.read(buffer.data(), buffer.size());
+        layout.decodeMaterials();
+        CHECK(layout.serialize() == buffer);
+    }
+}
+
+// nodes live in the document's arena, so documents move but never copy
+static_assert(!std::is_copy_constructible_v<brlyt::Brlyt> && !std::is_copy_assignable_v<brlyt::Brlyt>);
+static_assert(std::is_move_constructible_v<brlyt::Brlyt>);
+
+TEST(roundtrip, movedDocument) {
+    auto buffer = generateLayout(LayoutParams()).serialize();
+    auto source = std::make_unique<brlyt::Brlyt>();
+    source->read(buffer.data(), buffer.size());
+    auto arena = source->arena.get();
+    brlyt::Brlyt moved(std::move(*source));
+    source.reset();
+    CHECK(moved.arena.get() == arena);
+    CHECK(moved.serialize() == buffer);
+}
+
+TEST(roundtrip, lazyMaterialOutlivesDocument) {
+    for (bool bigEndian: {true, false}) {
+        LayoutParams params;
+        params.bigEndian = bigEndian;
+        auto source = std::make_unique<brlyt::Brlyt>(generateLayout(params));
+        auto buffer = source->serialize();
+        source = std::make_unique<brlyt::Brlyt>();
+        source->readOptions.lazyMaterials = true;
+        source->read(buffer.data(), buffer.size());
+
+        brlyt::Brlyt target;
+        target.bom = source->bom;
+        // texture references are indices into txl1, so the target needs the same list to decode them
+        target.txl1 = source->txl1;
+        std::vector<std::vector<char>> expected;
+        for (auto &material: source->mat1.materials) {
+            // get() so the copy stays encoded
+            CHECK(!material.get()->isDecoded());
+            expected.push_back(writeMaterial(*material.get(), *source));
+            target.mat1.materials.push_back(std::make_shared<brlyt::Material>(*material.get()));
+        }
+        buffer = {};
+        source.reset();
+
+        for (std::size_t i=0; i<expected.size(); ++i) {
+            CHECK(writeMaterial(*target.mat1.materials[i].get(), target) == expected[i]);
+        }
+        target.decodeMaterials();
+        for (std::size_t i=0; i<expected.size(); ++i) {
+            CHECK(writeMaterial(*target.mat1.materials[i], target) == expected[i]);
+        }
+    }
+}
+
+TEST(roundtrip, lazyMaterialEdits) {
+    for (auto &params: layoutCorpus()) {
+        auto buffer = generateLayout(params).serialize();
+        brlyt::Brlyt eager;
+        eager.read(buffer.data(), buffer.size());
+        brlyt::Brlyt lazy;
+        lazy.readOptions.lazyMaterials = true;
+        lazy.read(buffer.data(), buffer.size());
+
+        // reading through the pointer decodes, so the fields match an eager read
+        auto &first = lazy.mat1.materials.front();
+        CHECK(!first.get()->isDecoded());
+        CHECK(first->tevColors == eager.mat1.materials.front()->tevColors);
+        CHECK(first.get()->isDecoded());
+        CHECK(first->tevStages.size() == eager.mat1.materials.front()->tevStages.size());
+
+        // edits before any explicit decode must survive the write
+        auto &last = lazy.mat1.materials.back();
+        CHECK(!last.get()->isDecoded());
+        last->matColor = {1, 2, 3, 4};
+        last->setHasMaterialColor(true);
+        eager.mat1.materials.back()->matColor = {1, 2, 3, 4};
+        eager.mat1.materials.back()->setHasMaterialColor(true);
+        auto edited = lazy.serialize();
+        CHECK(edited == eager.serialize());
+        CHECK(edited != buffer);
+
+        brlyt::Brlyt reread;
+        reread.read(edited.data(), edited.size());
+        CHECK(reread.mat1.materials.back()->hasMaterialColor());
+        CHECK(reread.mat1.materials.back()->matColor == color8({1, 2, 3, 4}));
+    }
+}
@@ -0,0 +1,139 @@
+#include "test.h"
+#include "generator.h"
+
+using namespace bq;
+using namespace bq::generator;
+
+TEST(sections, sectionDirectory) {
+    for (bool bigEndian: {true, false}) {
+        LayoutParams params;
+        params.bigEndian = bigEndian;
+        auto buffer = generateLayout(params).serialize();
+        brlyt::Brlyt layout;
+        BinaryReader reader(buffer.data(), buffer.size());
+        auto directory = layout.scan(reader);
+        CHECK(!directory.empty());
+        CHECK(directory.front().magic == brlyt::Lyt1::FOURCC);
+        for (auto magic: {brlyt::Lyt1::FOURCC, Txl1<true>::FOURCC, Fnl1<true>::FOURCC, brlyt::Mat1::FOURCC}) {
+            auto entry = findSection(directory, magic);
+            CHECK(entry != nullptr);
+            layout.readSection(reader, *entry);
+        }
+
+        brlyt::Brlyt full;
+        full.read(buffer.data(), buffer.size());
+        CHECK(layout.txl1.textures == full.txl1.textures);
+        CHECK(layout.fnl1.fonts == full.fnl1.fonts);
+        CHECK(layout.mat1.materials.size() == full.mat1.materials.size());
+    }
+}
+
+TEST(sections, findSectionCountsOneMagic) {
+    auto buffer = generateLayout(LayoutParams()).serialize();
+    brlyt::Brlyt layout;
+    BinaryReader reader(buffer.data(), buffer.size());
+    auto directory = layout.scan(reader);
+    std::vector<const SectionEntry *> pictures;
+    for (auto &entry: directory) {
+        if (entry.magic == brlyt::Pic1::FOURCC) {
+            pictures.push_back(&entry);
+        }
+    }
+    CHECK(pictures.size() > 2);
+    for (std::size_t i=0; i<pictures.size(); ++i) {
+        CHECK(findSection(directory, brlyt::Pic1::FOURCC, i) == pictures[i]);
+    }
+    CHECK(findSection(directory, brlyt::Pic1::FOURCC, pictures.size()) == nullptr);
+    CHECK(findSection(directory, fourcc("none")) == nullptr);
+}
+
+TEST(sections, readSectionTwice) {
+    for (bool bigEndian: {true, false}) {
+        LayoutParams layoutParams;
+        layoutParams.bigEndian = bigEndian;
+        auto layoutBuffer = generateLayout(layoutParams).serialize();
+        brlyt::Brlyt layout;
+        BinaryReader layoutReader(layoutBuffer.data(), layoutBuffer.size());
+        auto layoutDirectory = layout.scan(layoutReader);
+        for (auto magic: {Txl1<true>::FOURCC, Fnl1<true>::FOURCC, brlyt::Mat1::FOURCC, Txl1<true>::FOURCC, Fnl1<true>::FOURCC, brlyt::Mat1::FOURCC}) {
+            layout.readSection(layoutReader, *findSection(layoutDirectory, magic));
+        }
+        CHECK(layout.txl1.textures.size() == layoutParams.textureCount);
+        CHECK(layout.fnl1.fonts.size() == layoutParams.fontCount);
+        CHECK(layout.mat1.materials.size() == layoutParams.materialCount);
+
+        AnimationParams animationParams;
+        animationParams.bigEndian = bigEndian;
+        auto expected = generateAnimation(animationParams);
+        auto animationBuffer = expected.serialize();
+        brlan::Brlan animation;
+        BinaryReader animationReader(animationBuffer.data(), animationBuffer.size());
+        auto animationDirectory = animation.scan(animationReader);
+        for (auto magic: {brlan::Pat1::FOURCC, brlan::Pai1::FOURCC, brlan::Pat1::FOURCC, brlan::Pai1::FOURCC}) {
+            animation.readSection(animationReader, *findSection(animationDirectory, magic));
+        }
+        CHECK(!expected.animationTag.groups.empty() && !expected.animationInfo.textures.empty());
+        CHECK(animation.animationTag.groups.size() == expected.animationTag.groups.size());
+        CHECK(animation.animationInfo.textures.size() == expected.animationInfo.textures.size());
+        CHECK(animation.animationInfo.entries.size() == expected.animationInfo.entries.size());
+    }
+}
+
+template<class Pane>
+static std::vector<char> writePane(Pane &pane, const brlyt::Brlyt &layout) {
+    BinaryWriter writer;
+    withEndian(layout.revEndian(), [&](auto endian) {
+        pane.template write<decltype(endian)::value>(writer, layout);
+    });
+    return writer.release();
+}
+
+static const FixedName<0x14> *materialName(BasePane &pane) {
+    if (auto picture = dynamic_cast<brlyt::Pic1 *>(&pane)) {
+        return &picture->material->name;
+    }
+    if (auto text = dynamic_cast<brlyt::Txt1 *>(&pane)) {
+        return &text->material->name;
+    }
+    return nullptr;
+}
+
+TEST(sections, readPaneMatchesFullRead) {
+    for (bool bigEndian: {true, false}) {
+        LayoutParams params;
+        params.bigEndian = bigEndian;
+        params.paneCount = 64;
+        auto buffer = generateLayout(params).serialize();
+        brlyt::Brlyt full;
+        full.read(buffer.data(), buffer.size());
+
+        brlyt::Brlyt layout;
+        BinaryReader reader(buffer.data(), buffer.size());
+        auto directory = layout.scan(reader);
+        std::size_t panes = 0;
+        for (std::size_t i=0; i<directory.size(); ++i) {
+            auto magic = directory[i].magic;
+            if (magic != brlyt::Pan1::FOURCC && magic != brlyt::Pic1::FOURCC && magic != brlyt::Txt1::FOURCC &&
+                    magic != brlyt::Bnd1::FOURCC && magic != brlyt::Wnd1::FOURCC) {
+                continue;
+            }
+            ++panes;
+            auto pane = layout.readPane(reader, directory, i);
+            auto expected = full.findPane(pane->name);
+            CHECK(expected != nullptr);
+            CHECK(pane->kind == expected->kind);
+            // standalone: nothing links it into the tree
+            CHECK(pane->children.empty());
+            CHECK(pane->parent.expired());
+            CHECK(layout.findPane(pane->name) == nullptr);
+            auto name = materialName(*pane);
+            auto expectedName = materialName(*expected);
+            CHECK((name == nullptr) == (expectedName == nullptr));
+            CHECK(!name || *name == *expectedName);
+            auto bytes = brlyt::visitPane(*pane, [&](auto &p) { return writePane(p, layout); });
+            auto expectedBytes = brlyt::visitPane(*expected, [&](auto &p) { return writePane(p, full); });
+            CHECK(bytes == expectedBytes);
+        }
+        CHECK(panes == full.paneTable.size());
+    }
+}
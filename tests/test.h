@@ -0,0 +1,58 @@
+#include "common.h"
+
+#ifndef BECQUEREL_TEST_H
+#define BECQUEREL_TEST_H
+
+namespace bq::test {
+
+struct TestCase {
+    const char *suite;
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &registry();
+
+struct Registration {
+    Registration(const char *suite, const char *name, void (*run)()) {
+        registry().push_back({suite, name, run});
+    };
+};
+
+/**
+ * @brief thrown by CHECK, ends the current test
+ */
+struct Failure : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] void fail(const char *file, int line, const char *expression);
+
+}
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static bq::test::Registration suite##_##name##_registration(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            bq::test::fail(__FILE__, __LINE__, #expression); \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(expression, exceptionType) \
+    do { \
+        bool thrown = false; \
+        try { \
+            expression; \
+        } catch (const exceptionType &) { \
+            thrown = true; \
+        } \
+        if (!thrown) { \
+            bq::test::fail(__FILE__, __LINE__, #expression " throws " #exceptionType); \
+        } \
+    } while (0)
+
+#endif